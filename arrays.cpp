@@ -0,0 +1,127 @@
+// GCC only auto-vectorizes at -O3 by default; turn it on for the kernels
+// in this file so they are SIMD under the usual -O2 build as well
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("tree-vectorize")
+#endif
+
+#include "arrays.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+// Independent accumulators for floating-point reductions. Without them the
+// compiler must keep the sequential order and cannot vectorize; the price
+// is that vogno sums may differ from a left-to-right loop in the last bits.
+static const size_t LANES = 4;
+
+template <typename T>
+static void fillKernel(T *__restrict a, size_t n, T v) {
+  for (size_t i = 0; i < n; i++) a[i] = v;
+}
+
+template <typename T>
+static void addScalarKernel(T *__restrict a, size_t n, T v) {
+  for (size_t i = 0; i < n; i++) a[i] += v;
+}
+
+template <typename T>
+static void mulScalarKernel(T *__restrict a, size_t n, T v) {
+  for (size_t i = 0; i < n; i++) a[i] *= v;
+}
+
+template <typename T, typename U>
+static void addArrayKernel(T *__restrict a, const U *__restrict b, size_t n) {
+  for (size_t i = 0; i < n; i++) a[i] += b[i];
+}
+
+template <typename T, typename U>
+static void mulArrayKernel(T *__restrict a, const U *__restrict b, size_t n) {
+  for (size_t i = 0; i < n; i++) a[i] *= b[i];
+}
+
+// a and b may be the same array (jog(a, a)); the kernels still work
+// element by element, so only the restrict promise needs care
+template <typename T, typename U>
+static void addArraySafe(T *a, const U *b, size_t n) {
+  if ((const void *)a == (const void *)b) {
+    mulScalarKernel(a, n, (T)2);
+  } else {
+    addArrayKernel(a, b, n);
+  }
+}
+
+template <typename T, typename U>
+static void mulArraySafe(T *a, const U *b, size_t n) {
+  if ((const void *)a == (const void *)b) {
+    for (size_t i = 0; i < n; i++) a[i] *= a[i];
+  } else {
+    mulArrayKernel(a, b, n);
+  }
+}
+
+void fillArray(int *a, size_t n, int v) { fillKernel(a, n, v); }
+void fillArray(double *a, size_t n, double v) { fillKernel(a, n, v); }
+void addScalar(int *a, size_t n, int v) { addScalarKernel(a, n, v); }
+void addScalar(double *a, size_t n, double v) { addScalarKernel(a, n, v); }
+void mulScalar(int *a, size_t n, int v) { mulScalarKernel(a, n, v); }
+void mulScalar(double *a, size_t n, double v) { mulScalarKernel(a, n, v); }
+void addArray(int *a, const int *b, size_t n) { addArraySafe(a, b, n); }
+void addArray(double *a, const double *b, size_t n) { addArraySafe(a, b, n); }
+void addArray(double *a, const int *b, size_t n) { addArrayKernel(a, b, n); }
+void mulArray(int *a, const int *b, size_t n) { mulArraySafe(a, b, n); }
+void mulArray(double *a, const double *b, size_t n) { mulArraySafe(a, b, n); }
+void mulArray(double *a, const int *b, size_t n) { mulArrayKernel(a, b, n); }
+
+long long sumArray(const int *a, size_t n) {
+  long long total = 0;
+  for (size_t i = 0; i < n; i++) total += a[i];
+  return total;
+}
+
+double sumArray(const double *a, size_t n) {
+  double acc[LANES] = {0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) acc[j] += a[i + j];
+  }
+  double total = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) total += a[i];
+  return total;
+}
+
+int minArray(const int *a, size_t n) {
+  int m = a[0];
+  for (size_t i = 1; i < n; i++) m = a[i] < m ? a[i] : m;
+  return m;
+}
+
+int maxArray(const int *a, size_t n) {
+  int m = a[0];
+  for (size_t i = 1; i < n; i++) m = a[i] > m ? a[i] : m;
+  return m;
+}
+
+double minArray(const double *a, size_t n) {
+  double acc[LANES] = {a[0], a[0], a[0], a[0]};
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) acc[j] = a[i + j] < acc[j] ? a[i + j] : acc[j];
+  }
+  double m = min(min(acc[0], acc[1]), min(acc[2], acc[3]));
+  for (; i < n; i++) m = a[i] < m ? a[i] : m;
+  return m;
+}
+
+double maxArray(const double *a, size_t n) {
+  double acc[LANES] = {a[0], a[0], a[0], a[0]};
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) acc[j] = a[i + j] > acc[j] ? a[i + j] : acc[j];
+  }
+  double m = max(max(acc[0], acc[1]), max(acc[2], acc[3]));
+  for (; i < n; i++) m = a[i] > m ? a[i] : m;
+  return m;
+}
+
+bool isArrayStatement(const string &name) { return name == "bhoro" || name == "jog" || name == "gun"; }
+bool isArrayReduction(const string &name) { return name == "jogfol" || name == "choto" || name == "boro"; }
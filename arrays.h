@@ -0,0 +1,61 @@
+#ifndef ARRAYS_H
+#define ARRAYS_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Largest element count accepted for a purno/vogno array declaration
+static const size_t MAX_ARRAY_SIZE = 1 << 26;
+
+// Fixed-size, zero-initialised array whose storage starts on a 64-byte
+// boundary so the bulk kernels below work on whole cache lines
+template <typename T>
+class AlignedArray {
+  static const size_t ALIGNMENT = 64;
+
+  unique_ptr<char[]> storage;
+  T *elems;
+  size_t count;
+
+ public:
+  explicit AlignedArray(size_t n) : storage(new char[n * sizeof(T) + ALIGNMENT]), count(n) {
+    void *p = storage.get();
+    size_t space = n * sizeof(T) + ALIGNMENT;
+    elems = static_cast<T *>(align(ALIGNMENT, n * sizeof(T), p, space));
+    memset(elems, 0, n * sizeof(T));
+  }
+
+  T *data() { return elems; }
+  const T *data() const { return elems; }
+  size_t size() const { return count; }
+  T &operator[](size_t i) { return elems[i]; }
+};
+
+// Whole-array kernels behind bhoro, jog, gun, jogfol, choto and boro.
+// Simple counted loops over non-aliasing pointers, which the compiler
+// turns into SIMD code.
+void fillArray(int *a, size_t n, int v);
+void fillArray(double *a, size_t n, double v);
+void addScalar(int *a, size_t n, int v);
+void addScalar(double *a, size_t n, double v);
+void mulScalar(int *a, size_t n, int v);
+void mulScalar(double *a, size_t n, double v);
+void addArray(int *a, const int *b, size_t n);
+void addArray(double *a, const double *b, size_t n);
+void addArray(double *a, const int *b, size_t n);
+void mulArray(int *a, const int *b, size_t n);
+void mulArray(double *a, const double *b, size_t n);
+void mulArray(double *a, const int *b, size_t n);
+long long sumArray(const int *a, size_t n);
+double sumArray(const double *a, size_t n);
+int minArray(const int *a, size_t n);
+double minArray(const double *a, size_t n);
+int maxArray(const int *a, size_t n);
+double maxArray(const double *a, size_t n);
+
+// Built-in names. They are not keywords: a name only acts as a built-in
+// when it is called and is not a declared variable.
+bool isArrayStatement(const string &name);  // bhoro, jog, gun
+bool isArrayReduction(const string &name);  // jogfol, choto, boro
+
+#endif // ARRAYS_H
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Time each benchmark program with a built compiler binary.
+# usage: benchmarks/run.sh [path/to/compiler] [benchmark.txt ...]
+# Programs that print "calls: N" also get a calls-per-second figure.
+
+compiler=$(cd "$(dirname "${1:-./compiler}")" && pwd)/$(basename "${1:-./compiler}")
+[ $# -gt 0 ] && shift
+dir=$(cd "$(dirname "$0")" && pwd)
+[ $# -eq 0 ] && set -- "$dir"/*.txt
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+for program in "$@"; do
+  cp "$program" "$work/code.txt"
+  start=$(date +%s%N)
+  output=$(cd "$work" && "$compiler")
+  end=$(date +%s%N)
+  ms=$(( (end - start) / 1000000 ))
+  calls=$(printf '%s\n' "$output" | sed -n 's/^calls: //p')
+  printf '%-24s %8d ms' "$(basename "$program")" "$ms"
+  [ -n "$calls" ] && [ "$ms" -gt 0 ] && printf '  %d calls/s' $(( calls * 1000 / ms ))
+  printf '  | %s\n' "$(printf '%s' "$output" | tr '\n' ' ')"
+done
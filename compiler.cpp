@@ -1,26 +1,115 @@
 #include "parser.h"
+#include "memstats.h"
+#include "server.h"
 #include <bits/stdc++.h>
 #include <fstream>
 
 using namespace std;
 
-int main() {
-  ifstream file("code.txt");
+static void usage() {
+  cerr << "Usage: compiler [--max-steps N] [--time-limit MS] [--max-output BYTES]"
+       << " [--max-depth N] [--lex-threads N] [--mem-stats[=text|json]]" << endl;
+  cerr << "       compiler --serve SOCKET [--workers N] [--cache-size N] [--cache-bytes BYTES]"
+       << " [--max-source BYTES] [limits...]" << endl;
+}
+
+// Parse a non-negative whole-number option value, rejecting anything else
+static bool parseCount(const char *text, long long &value) {
+  char *end;
+  errno = 0;
+  value = strtoll(text, &end, 10);
+  return end != text && *end == '\0' && errno == 0 && value >= 0;
+}
+
+int main(int argc, char *argv[]) {
+  ExecutionLimits limits;
+  ServerOptions server;
+  server.workers = max(4u, thread::hardware_concurrency());
+  bool memStats = false, memStatsJson = false;
+  int lexThreads = 1;
+  bool timeLimitSet = false, maxOutputSet = false;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--mem-stats" || arg == "--mem-stats=text") {
+      memStats = true;
+      continue;
+    }
+    if (arg == "--mem-stats=json") {
+      memStats = memStatsJson = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    if (arg == "--serve") {
+      server.socketPath = argv[++i];
+      continue;
+    }
+    long long value;
+    if (!parseCount(argv[++i], value)) {
+      cerr << "Error: Invalid value '" << argv[i] << "' for " << arg << "." << endl;
+      usage();
+      return 1;
+    }
+    if (arg == "--workers") server.workers = (int)value;
+    else if (arg == "--cache-size") server.cacheSize = (size_t)value;
+    else if (arg == "--cache-bytes") server.cacheBytes = (size_t)value;
+    else if (arg == "--max-source") server.maxSourceBytes = (size_t)value;
+    else if (arg == "--lex-threads") lexThreads = value > 0 ? (int)value : (int)thread::hardware_concurrency();
+    else if (arg == "--max-steps") limits.maxSteps = value;
+    else if (arg == "--time-limit") {
+      limits.timeLimitMs = value;
+      timeLimitSet = true;
+    } else if (arg == "--max-output") {
+      limits.maxOutputBytes = value;
+      maxOutputSet = true;
+    } else if (arg == "--max-depth") {
+      limits.maxCallDepth = (int)value;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (!server.socketPath.empty()) {
+    if (!timeLimitSet) limits.timeLimitMs = DEFAULT_SERVE_TIME_LIMIT_MS;
+    if (!maxOutputSet) limits.maxOutputBytes = DEFAULT_SERVE_MAX_OUTPUT;
+    server.limits = limits;
+    return runServer(server);
+  }
+  if (memStats) enableMemStats();
+
+  ifstream file("code.txt", ios::binary);
   if (!file.is_open()) {
     cerr << "Error: Could not open code.txt" << endl;
     return 1;
   }
 
-  string code;
-  string line;
-  while (getline(file, line)) {
-    code += line + '\n';
+  RunStatus status;
+  if (lexThreads > 1) {
+    // Whole source is lexed up front, split across threads
+    vector<Token> tokens;
+    {
+      MemPhaseScope phase(PHASE_LEX);
+      ostringstream contents;
+      contents << file.rdbuf();
+      tokens = tokenizeParallel(contents.str(), lexThreads);
+    }
+    unique_ptr<Parser> parser;
+    {
+      MemPhaseScope phase(PHASE_PARSE);  // window and brace table
+      parser.reset(new Parser(std::move(tokens)));
+    }
+    parser->setLimits(limits);
+    status = parser->run();
+  } else {
+    // Source is lexed on demand while the program runs
+    Lexer lexer(file);
+    Parser parser(lexer);
+    parser.setLimits(limits);
+    status = parser.run();
   }
-  file.close();
-
-  auto tokens = tokenize(code);
-  Parser parser(tokens);
-  parser.run();
 
-  return 0;
-}
\ No newline at end of file
+  if (memStats) printMemStats(cerr, memStatsJson);
+  return status;
+}
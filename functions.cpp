@@ -0,0 +1,824 @@
+#include "parser.h"
+#include "functions.h"
+#include <bits/stdc++.h>
+using namespace std;
+
+int operatorPrecedence(const string &op) {
+    if (op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=")
+      return 4;  // Comparison operators
+    if (op == "&&") return 3;  // Logical AND
+    if (op == "||") return 2;  // Logical OR
+    if (op == "+" || op == "-") return 1;
+    if (op == "*" || op == "/") return 1;
+    return 0;
+}
+
+static BinaryOp binaryOp(const string &op) {
+    static const unordered_map<string, BinaryOp> ops = {
+        {"+", OP_ADD}, {"-", OP_SUB}, {"*", OP_MUL}, {"/", OP_DIV}, {"<", OP_LT}, {">", OP_GT},
+        {"<=", OP_LE}, {">=", OP_GE}, {"==", OP_EQ}, {"!=", OP_NE}, {"&&", OP_AND}, {"||", OP_OR}};
+    return ops.at(op);
+}
+
+static bool isBinaryOperator(const Token &t) {
+    return t.type == "OPERATOR" && operatorPrecedence(t.value) > 0;
+}
+
+// Expand \n and \t in a dekhao string once, at compile time
+static string unescape(const string &s) {
+    string result;
+    for (size_t i = 0; i < s.length(); i++) {
+      if (s[i] == '\\' && i + 1 < s.length() && (s[i + 1] == 'n' || s[i + 1] == 't')) {
+        result += s[i + 1] == 'n' ? '\n' : '\t';
+        i++;
+      } else {
+        result += s[i];
+      }
+    }
+    return result;
+}
+
+static int addExpr(Function &fn, const Expr &e) {
+    fn.exprs.push_back(e);
+    return (int)fn.exprs.size() - 1;
+}
+
+static int addConst(Function &fn, double value) {
+    Expr e;
+    e.value = value;
+    return addExpr(fn, e);
+}
+
+bool assignOpFor(const string &op, AssignOp &result) {
+    static const unordered_map<string, AssignOp> ops = {
+        {"=", ASSIGN_SET}, {"+=", ASSIGN_ADD}, {"-=", ASSIGN_SUB}, {"*=", ASSIGN_MUL},
+        {"/=", ASSIGN_DIV}, {"++", ASSIGN_INC}, {"--", ASSIGN_DEC}};
+    auto it = ops.find(op);
+    if (it == ops.end()) return false;
+    result = it->second;
+    return true;
+}
+
+// Slot of 'name' in the function table, adding an undefined entry so a body
+// can call a function whose definition comes later
+int Parser::functionSlot(const string& name) {
+    auto it = functionIndex.find(name);
+    if (it != functionIndex.end()) return it->second;
+    functions.emplace_back(new Function());
+    functions.back()->name = name;
+    functionIndex[name] = (int)functions.size() - 1;
+    return (int)functions.size() - 1;
+}
+
+// kaj and ferot are not reserved. A statement starting with one of them is a
+// definition or a return only where it could not be a variable statement.
+bool Parser::startsDefinition(const Token& t) {
+    return t.type == "IDENTIFIER" && t.value == "kaj" && (peek().type == "KEYWORD" || peek().type == "IDENTIFIER");
+}
+
+bool Parser::startsReturn(const Token& t) {
+    AssignOp op;
+    return t.type == "IDENTIFIER" && t.value == "ferot" && peek().value != "[" && !assignOpFor(peek().value, op);
+}
+
+// True once a kaj definition for the name has been reached
+bool Parser::isFunction(const string& name) {
+    auto it = functionIndex.find(name);
+    return it != functionIndex.end() && functions[it->second]->definedAt >= 0;
+}
+
+void Parser::compileError(Function& fn, const string& message) {
+    // Once the run has halted, the rest of an unfinished body is not worth reporting
+    if (status == RUN_OK)
+      err << "Error: " << message << " in function '" << fn.name << "' at line " << peek().line << "." << endl;
+    fn.valid = false;
+}
+
+bool Parser::expect(Function& fn, const string& value, const string& context) {
+    if (peek().value == value) {
+      get();
+      return true;
+    }
+    compileError(fn, "Expected '" + value + "' " + context + ", but got '" + peek().value + "'");
+    return false;
+}
+
+// Jump past the rest of a definition whose header could not be used
+void Parser::skipDefinition() {
+    while (peek().value != "{" && peek().type != "EOF") get();
+    if (peek().value == "{") skipBlock();
+}
+
+// kaj [purno|vogno] name(type param, ...) { body }
+void Parser::defineFunction() {
+    int start = pos - 1;
+    Function proto;
+    if (peek().value == "purno" || peek().value == "vogno") {
+      proto.returnType = get().value == "purno" ? TYPE_PURNO : TYPE_VOGNO;
+    } else if (peek().value == "shobdo") {
+      err << "Error: Functions cannot return 'shobdo'." << endl;
+      skipDefinition();
+      return;
+    }
+    Token name = get();
+    if (name.type != "IDENTIFIER") {
+      err << "Error: Expected a function name after 'kaj', but got '" << name.value << "'." << endl;
+      skipDefinition();
+      return;
+    }
+    proto.name = name.value;
+
+    auto it = functionIndex.find(name.value);
+    if (it != functionIndex.end() && functions[it->second]->definedAt == start) {
+      // Reached again from inside a loop body; the body is already compiled
+      skipDefinition();
+      return;
+    }
+    if (it != functionIndex.end() && functions[it->second]->definedAt >= 0) {
+      err << "Error: Redefinition of function '" << name.value << "'." << endl;
+      skipDefinition();
+      return;
+    }
+    if (isDeclared(name.value)) {
+      err << "Error: '" << name.value << "' is already declared as a variable." << endl;
+      skipDefinition();
+      return;
+    }
+    if (isArrayStatement(name.value) || isArrayReduction(name.value)) {
+      err << "Error: '" << name.value << "' is a built-in function." << endl;
+      skipDefinition();
+      return;
+    }
+    if (name.value == "kaj" || name.value == "ferot") {
+      err << "Error: '" << name.value << "' cannot be used as a function name." << endl;
+      skipDefinition();
+      return;
+    }
+
+    scopes.assign(1, unordered_map<string, int>());
+    bool ok = expect(proto, "(", "after function name '" + name.value + "'");
+    while (ok && peek().value != ")" && peek().type != "EOF") {
+      string type = get().value;
+      Token param = get();
+      if ((type != "purno" && type != "vogno") || param.type != "IDENTIFIER") {
+        compileError(proto, "Parameters must be declared as 'purno name' or 'vogno name'");
+        ok = false;
+        break;
+      }
+      if (scopes[0].count(param.value)) compileError(proto, "Duplicate parameter '" + param.value + "'");
+      scopes[0][param.value] = (int)proto.slots.size();
+      proto.slots.push_back(type == "purno" ? TYPE_PURNO : TYPE_VOGNO);
+      proto.slotNames.push_back(param.value);
+      if (peek().value == ",") get();
+      else if (peek().value != ")") ok = expect(proto, ")", "after parameters");
+    }
+    if (ok) ok = expect(proto, ")", "after parameters");
+    proto.params = (int)proto.slots.size();
+    if (!ok || peek().value != "{") {
+      if (ok) compileError(proto, "Expected '{' to start the body");
+      skipDefinition();
+      scopes.clear();
+      return;
+    }
+
+    // Register the signature before the body so it can call itself
+    Function &fn = *functions[functionSlot(name.value)];
+    fn = std::move(proto);
+    fn.definedAt = start;
+    compileBlock(fn, fn.body);
+    scopes.clear();
+}
+
+void Parser::compileBlock(Function& fn, vector<int>& into) {
+    get();  // '{'
+    scopes.emplace_back();
+    while (status == RUN_OK && peek().value != "}" && peek().type != "EOF") compileStatement(fn, into);
+    if (peek().value == "}") get();
+    scopes.pop_back();
+}
+
+void Parser::compileStatement(Function& fn, vector<int>& into) {
+    if (stackExhausted()) {
+      halt(RUN_DEPTH_LIMIT);
+      return;
+    }
+    Token t = get();
+    Stmt st;
+
+    if (t.value == "purno" || t.value == "vogno") {
+      ValueType type = t.value == "purno" ? TYPE_PURNO : TYPE_VOGNO;
+      do {
+        Token var = get();
+        if (var.type != "IDENTIFIER" || peek().value == "[") {
+          compileError(fn, var.type == "IDENTIFIER" ? "Arrays cannot be declared"
+                                                    : "Expected a variable name after '" + t.value + "'");
+          skipStatement();
+          return;
+        }
+        if (scopes.back().count(var.value)) compileError(fn, "Redeclaration of variable '" + var.value + "'");
+        int slot = (int)fn.slots.size();
+        fn.slots.push_back(type);
+        fn.slotNames.push_back(var.value);
+        scopes.back()[var.value] = slot;
+
+        // Each execution of the declaration resets the local, to zero if it has no initializer
+        Expr local;
+        local.kind = EXPR_LOCAL;
+        local.slot = slot;
+        local.name = var.value;
+        Stmt decl;
+        decl.kind = STMT_ASSIGN;
+        decl.target = addExpr(fn, local);
+        if (peek().value == "=") {
+          get();  // '='
+          decl.expr = compileExpression(fn);
+        }
+        fn.stmts.push_back(decl);
+        into.push_back((int)fn.stmts.size() - 1);
+      } while (get().value == ",");
+      return;
+    }
+
+    if (t.value == "jodi") {
+      bool isElse = false;
+      for (;;) {
+        int cond = -1;
+        if (!isElse) {
+          if (!expect(fn, "(", "after 'jodi'")) {
+            skipStatement();
+            return;
+          }
+          cond = compileExpression(fn, ")");
+          if (!expect(fn, ")", "after jodi condition")) {
+            skipStatement();
+            return;
+          }
+        }
+        if (peek().value != "{") {
+          compileError(fn, "Expected '{' after " + string(isElse ? "nahole" : "jodi condition"));
+          return;
+        }
+        vector<int> block;
+        compileBlock(fn, block);
+        st.branches.push_back(make_pair(cond, block));
+        if (isElse || peek().value != "nahole") break;
+        get();  // 'nahole'
+        if (peek().value == "jodi") get();
+        else isElse = true;
+      }
+      st.kind = STMT_IF;
+    } else if (t.value == "jotokkhon") {
+      if (!expect(fn, "(", "after 'jotokkhon'")) {
+        skipStatement();
+        return;
+      }
+      st.expr = compileExpression(fn, ")");
+      if (!expect(fn, ")", "after jotokkhon condition")) {
+        skipStatement();
+        return;
+      }
+      if (peek().value != "{") {
+        compileError(fn, "Expected '{' after jotokkhon condition");
+        return;
+      }
+      compileBlock(fn, st.body);
+      st.kind = STMT_WHILE;
+    } else if (t.value == "dekhao") {
+      if (peek().value != "<<") {
+        compileError(fn, "Expected '<<' after 'dekhao'");
+        skipStatement();
+        return;
+      }
+      do {
+        get();  // '<<'
+        Token nxt = get();
+        PrintItem item;
+        if (nxt.type == "STRING") {
+          item.text = unescape(nxt.value);
+        } else if (nxt.type == "PURNO_LITERAL" || nxt.type == "VOGNO_LITERAL") {
+          item.text = nxt.value;
+        } else if (nxt.type == "IDENTIFIER" && localSlot(nxt.value) < 0 && shobdoTable.count(nxt.value)) {
+          item.shobdo = &shobdoTable[nxt.value];
+        } else if (nxt.type == "IDENTIFIER") {
+          item.expr = compileOperand(fn, nxt, true);
+        } else {
+          compileError(fn, "Expected a variable, string, or number after '<<', but got '" + nxt.value + "'");
+          skipStatement();
+          return;
+        }
+        st.items.push_back(item);
+      } while (peek().value == "<<");
+      if (!expect(fn, ";", "at the end of the dekhao statement")) skipStatement();
+      st.kind = STMT_PRINT;
+    } else if (t.value == "nao") {
+      if (peek().value != ">>") {
+        compileError(fn, "Expected '>>' after 'nao'");
+        skipStatement();
+        return;
+      }
+      do {
+        get();  // '>>'
+        int target = compileTarget(fn, get().value);
+        if (target >= 0) st.targets.push_back(target);
+      } while (peek().value == ">>");
+      if (peek().value == ";") get();
+      st.kind = STMT_INPUT;
+    } else if (startsReturn(t)) {
+      if (peek().value != ";") {
+        if (fn.returnType == TYPE_NONE) compileError(fn, "'ferot' with a value in a function without a return type");
+        st.expr = compileExpression(fn);
+      } else if (fn.returnType != TYPE_NONE) {
+        compileError(fn, "'ferot' needs a value");
+      }
+      if (peek().value == ";") get();
+      st.kind = STMT_RETURN;
+    } else if (startsDefinition(t)) {
+      compileError(fn, "Nested function definition");
+      skipDefinition();
+      return;
+    } else if (t.type == "IDENTIFIER" && peek().value == "(" && isArrayStatement(t.value) &&
+               localSlot(t.value) < 0 && !isDeclared(t.value)) {
+      compileError(fn, "'" + t.value + "' statements are not supported");
+      skipStatement();
+      return;
+    } else if (t.type == "IDENTIFIER" && peek().value == "(") {
+      st.expr = compileOperand(fn, t, false);  // a call, or a reduction whose value is dropped
+      if (peek().value == ";") get();
+      st.kind = STMT_CALL;
+    } else if (t.type == "IDENTIFIER") {
+      st.target = compileTarget(fn, t.value);
+      if (st.target < 0) {
+        skipStatement();
+        return;
+      }
+      string op = get().value;
+      if (!assignOpFor(op, st.op)) {
+        compileError(fn, "Invalid operation '" + op + "' for variable '" + t.value + "'");
+        skipStatement();
+        return;
+      }
+      if (st.op != ASSIGN_INC && st.op != ASSIGN_DEC) st.expr = compileExpression(fn);
+      if (peek().value == ";") get();
+      st.kind = STMT_ASSIGN;
+    } else if (t.value == "shobdo") {
+      compileError(fn, "'" + t.value + "' statements are not supported");
+      skipStatement();
+      return;
+    } else {
+      compileError(fn, "Unexpected '" + t.value + "'");
+      if (t.value != ";" && t.value != "}") skipStatement();
+      return;
+    }
+    fn.stmts.push_back(st);
+    into.push_back((int)fn.stmts.size() - 1);
+}
+
+// Shunting-yard over the same operators and precedence as parseExpression,
+// building a tree instead of evaluating
+int Parser::compileExpression(Function& fn, const string& stopAt) {
+    if (stackExhausted()) {
+      halt(RUN_DEPTH_LIMIT);
+      return addConst(fn, 0);
+    }
+    vector<int> operands;
+    vector<string> ops;
+    int depth = 0;  // open parentheses inside this expression
+    bool invalid = false;
+
+    auto reduce = [&]() {
+      Expr e;
+      e.kind = EXPR_BINARY;
+      e.slot = binaryOp(ops.back());
+      ops.pop_back();
+      if (operands.size() < 2) {
+        invalid = true;
+        return;
+      }
+      e.right = operands.back();
+      operands.pop_back();
+      e.left = operands.back();
+      operands.pop_back();
+      operands.push_back(addExpr(fn, e));
+    };
+
+    while (peek().type != "EOF" && (stopAt.empty() || peek().value != stopAt || depth > 0)) {
+      Token t = peek();
+      if (t.type == "PURNO_LITERAL" || t.type == "VOGNO_LITERAL") {
+        get();
+        operands.push_back(addConst(fn, stod(t.value)));
+      } else if (t.type == "IDENTIFIER") {
+        get();
+        operands.push_back(compileOperand(fn, t, true));
+      } else if (t.value == "(") {
+        get();
+        ops.push_back("(");
+        depth++;
+      } else if (t.value == ")" && depth > 0) {
+        get();
+        while (ops.back() != "(") reduce();
+        ops.pop_back();
+        depth--;
+      } else if (isBinaryOperator(t)) {
+        get();
+        while (!ops.empty() && ops.back() != "(" &&
+               operatorPrecedence(ops.back()) >= operatorPrecedence(t.value))
+          reduce();
+        ops.push_back(t.value);
+      } else {
+        break;  // Not part of the expression
+      }
+    }
+    while (!ops.empty()) {
+      if (ops.back() == "(") ops.pop_back();
+      else reduce();
+    }
+
+    if (invalid) {
+      compileError(fn, "Invalid expression");
+      return addConst(fn, 0);
+    }
+    return operands.empty() ? addConst(fn, 0) : operands.back();
+}
+
+// Slot of the innermost local named 'name', -1 if it is not a local
+int Parser::localSlot(const string& name) {
+    for (auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
+      auto it = s->find(name);
+      if (it != s->end()) return it->second;
+    }
+    return -1;
+}
+
+// A variable, array element, call or reduction whose first token is 't'
+int Parser::compileOperand(Function& fn, const Token& t, bool needValue) {
+    bool variable = localSlot(t.value) >= 0 || isDeclared(t.value);
+    if (peek().value == "(" && isArrayReduction(t.value) && !variable) return compileReduction(fn, t.value);
+    if (peek().value == "(") return compileCall(fn, t.value, needValue);
+    if (peek().value == "[") return compileElement(fn, t.value);
+
+    Expr e;
+    e.name = t.value;
+    e.slot = localSlot(t.value);
+    if (e.slot >= 0) {
+      e.kind = EXPR_LOCAL;
+    } else if (purnoTable.count(t.value)) {
+      e.kind = EXPR_PURNO_GLOBAL;
+      e.purno = &purnoTable[t.value];
+    } else if (vognoTable.count(t.value)) {
+      e.kind = EXPR_VOGNO_GLOBAL;
+      e.vogno = &vognoTable[t.value];
+    } else if (isArray(t.value)) {
+      compileError(fn, "Array '" + t.value + "' used without an index");
+      return addConst(fn, 0);
+    } else {
+      compileError(fn, "Undeclared variable '" + t.value + "' used in expression (globals must be declared before 'kaj')");
+      return addConst(fn, 0);
+    }
+    return addExpr(fn, e);
+}
+
+// name(args) with the '(' next; the callee may be defined later
+int Parser::compileCall(Function& fn, const string& name, bool needValue) {
+    get();  // '('
+    Expr e;
+    e.kind = EXPR_CALL;
+    e.name = name;
+    if (peek().value != ")") {
+      for (;;) {
+        e.args.push_back(compileExpression(fn, ")"));
+        if (peek().value != ",") break;
+        get();  // ','
+      }
+    }
+    expect(fn, ")", "after arguments of '" + name + "'");
+
+    e.slot = functionSlot(name);
+    const Function &callee = *functions[e.slot];
+    if (callee.definedAt >= 0 && callee.params != (int)e.args.size())
+      compileError(fn, "Function '" + name + "' expects " + to_string(callee.params) + " arguments but got " +
+                       to_string(e.args.size()));
+    if (needValue && callee.definedAt >= 0 && callee.returnType == TYPE_NONE)
+      compileError(fn, "Function '" + name + "' does not return a value");
+    return addExpr(fn, e);
+}
+
+// Left-hand side of an assignment or nao: a local, a global, or an element
+int Parser::compileTarget(Function& fn, const string& name) {
+    bool local = localSlot(name) >= 0;
+    if (!local && shobdoTable.count(name)) {
+      compileError(fn, "'shobdo' variable '" + name + "' cannot be changed");
+      return -1;
+    }
+    if (!local && !isDeclared(name)) {
+      compileError(fn, "Undeclared variable '" + name + "' (globals must be declared before 'kaj')");
+      return -1;
+    }
+    Token t = {"IDENTIFIER", name, 0};
+    int target = compileOperand(fn, t, true);
+    return fn.exprs[target].kind == EXPR_CONST ? -1 : target;
+}
+
+int Parser::compileElement(Function& fn, const string& name) {
+    get();  // '['
+    Expr e;
+    e.name = name;
+    e.left = compileExpression(fn, "]");
+    expect(fn, "]", "after index of array '" + name + "'");
+    if (purnoArrays.count(name)) {
+      e.kind = EXPR_PURNO_ELEMENT;
+      e.purnoArray = &purnoArrays.at(name);
+    } else if (vognoArrays.count(name)) {
+      e.kind = EXPR_VOGNO_ELEMENT;
+      e.vognoArray = &vognoArrays.at(name);
+    } else {
+      compileError(fn, "'" + name + "' is not an array");
+      return addConst(fn, 0);
+    }
+    return addExpr(fn, e);
+}
+
+int Parser::compileReduction(Function& fn, const string& name) {
+    Expr e;
+    e.kind = EXPR_REDUCE;
+    e.slot = name == "jogfol" ? REDUCE_SUM : name == "choto" ? REDUCE_MIN : REDUCE_MAX;
+    if (!expect(fn, "(", "after '" + name + "'")) return addConst(fn, 0);
+    e.name = get().value;
+    if (!expect(fn, ")", "after '" + e.name + "' in '" + name + "'")) return addConst(fn, 0);
+    if (purnoArrays.count(e.name)) {
+      e.purnoArray = &purnoArrays.at(e.name);
+    } else if (vognoArrays.count(e.name)) {
+      e.vognoArray = &vognoArrays.at(e.name);
+    } else {
+      compileError(fn, "'" + e.name + "' is not an array");
+      return addConst(fn, 0);
+    }
+    return addExpr(fn, e);
+}
+
+// Runtime checks before a call: defined, compiled cleanly, right arity, depth
+bool Parser::callable(const Function& callee, size_t args) {
+    if (status != RUN_OK) return false;
+    if (callee.definedAt < 0) {
+      err << "Error: Undefined function '" << callee.name << "'." << endl;
+      return false;
+    }
+    if (!callee.valid) {
+      err << "Error: Function '" << callee.name << "' has errors and cannot be called." << endl;
+      return false;
+    }
+    if ((int)args != callee.params) {
+      err << "Error: Function '" << callee.name << "' expects " << callee.params << " arguments but got "
+          << args << "." << endl;
+      return false;
+    }
+    if (callDepth >= limits.maxCallDepth || stackExhausted()) {
+      halt(RUN_DEPTH_LIMIT);
+      return false;
+    }
+    return true;
+}
+
+// Claim the callee's slots on the frame stack. The stack only grows when a
+// call goes deeper than any before it, so steady-state calls never allocate.
+size_t Parser::pushFrame(const Function& callee) {
+    size_t frame = frameTop;
+    frameTop += callee.slots.size();
+    if (frameTop > frames.size()) frames.resize(max(frameTop, frames.size() * 2));
+    callDepth++;
+    return frame;
+}
+
+void Parser::setArg(const Function& callee, size_t frame, int i, double value) {
+    if (callee.slots[i] == TYPE_PURNO && value != floor(value)) {
+      err << "Error: Type mismatch. Cannot pass a non-integer value to integer parameter '"
+          << callee.slotNames[i] << "' of '" << callee.name << "'." << endl;
+      value = 0;
+    }
+    frames[frame + i] = value;
+}
+
+double Parser::runFrame(const Function& callee, size_t frame) {
+    double result = exec(callee, callee.body, frame) == EXEC_RETURN ? returned : 0;
+    frameTop = frame;
+    callDepth--;
+    return result;
+}
+
+// Call from the interpreted top level; arguments are evaluated before the frame is pushed
+double Parser::parseCall(const string& name, bool needValue) {
+    get();  // '('
+    vector<double> args;
+    if (peek().value != ")") {
+      for (;;) {
+        args.push_back(parseExpression(")"));
+        if (peek().value != ",") break;
+        get();  // ','
+      }
+    }
+    if (status != RUN_OK) return 0;
+    if (peek().value != ")") {
+      err << "Error: Expected ')' after arguments of '" << name << "'." << endl;
+      return 0;
+    }
+    get();  // ')'
+
+    auto it = functionIndex.find(name);
+    if (it == functionIndex.end()) {
+      err << "Error: Undefined function '" << name << "'." << endl;
+      return 0;
+    }
+    const Function &callee = *functions[it->second];
+    if (needValue && callee.definedAt >= 0 && callee.returnType == TYPE_NONE) {
+      err << "Error: Function '" << name << "' does not return a value." << endl;
+      return 0;
+    }
+    if (!callable(callee, args.size())) return 0;
+    size_t frame = pushFrame(callee);
+    for (size_t i = 0; i < args.size(); i++) setArg(callee, frame, (int)i, args[i]);
+    return runFrame(callee, frame);
+}
+
+// Run a compiled block; after EXEC_RETURN the value is in 'returned'
+ExecResult Parser::exec(const Function& fn, const vector<int>& block, size_t fp) {
+    if (stackExhausted()) {
+      halt(RUN_DEPTH_LIMIT);
+      return EXEC_HALT;
+    }
+    for (int s : block) {
+      if (!tick()) return EXEC_HALT;
+      const Stmt &st = fn.stmts[s];
+      switch (st.kind) {
+        case STMT_ASSIGN:
+          store(fn, st.target, st.op, st.expr >= 0 ? eval(fn, st.expr, fp) : 0, fp);
+          break;
+        case STMT_CALL:
+          eval(fn, st.expr, fp);
+          break;
+        case STMT_IF:
+          for (const auto &branch : st.branches) {
+            if (branch.first < 0 || eval(fn, branch.first, fp) != 0) {
+              ExecResult r = exec(fn, branch.second, fp);
+              if (r != EXEC_NEXT) return r;
+              break;
+            }
+          }
+          break;
+        case STMT_WHILE:
+          while (eval(fn, st.expr, fp) != 0 && tick()) {
+            ExecResult r = exec(fn, st.body, fp);
+            if (r != EXEC_NEXT) return r;
+          }
+          break;
+        case STMT_RETURN: {
+          double value = st.expr >= 0 ? eval(fn, st.expr, fp) : 0;
+          if (fn.returnType == TYPE_PURNO && value != floor(value)) {
+            err << "Error: Type mismatch. Function '" << fn.name << "' must return an integer value." << endl;
+            value = 0;
+          }
+          returned = value;
+          return EXEC_RETURN;
+        }
+        case STMT_PRINT:
+          for (const PrintItem &item : st.items) {
+            if (item.shobdo) out << *item.shobdo;
+            else if (item.expr < 0) out << item.text;
+            else if (isWhole(fn, item.expr)) out << (long long)eval(fn, item.expr, fp);
+            else out << eval(fn, item.expr, fp);
+            if (outBuf.exceeded()) {
+              halt(RUN_OUTPUT_LIMIT);
+              return EXEC_HALT;
+            }
+          }
+          break;
+        case STMT_INPUT:
+          for (int target : st.targets) {
+            double value = 0;
+            if (isWhole(fn, target)) {
+              int v = 0;
+              in >> v;
+              value = v;
+            } else {
+              in >> value;
+            }
+            store(fn, target, ASSIGN_SET, value, fp);
+          }
+          break;
+      }
+      if (status != RUN_OK) return EXEC_HALT;
+    }
+    return EXEC_NEXT;
+}
+
+double Parser::eval(const Function& fn, int index, size_t fp) {
+    const Expr &e = fn.exprs[index];
+    switch (e.kind) {
+      case EXPR_CONST: return e.value;
+      case EXPR_LOCAL: return frames[fp + e.slot];
+      case EXPR_PURNO_GLOBAL: return *e.purno;
+      case EXPR_VOGNO_GLOBAL: return *e.vogno;
+      case EXPR_PURNO_ELEMENT:
+      case EXPR_VOGNO_ELEMENT: {
+        size_t i;
+        if (!elementIndex(fn, e, fp, i)) return 0;
+        return e.kind == EXPR_PURNO_ELEMENT ? (*e.purnoArray)[i] : (*e.vognoArray)[i];
+      }
+      case EXPR_REDUCE:
+        if (e.purnoArray) {
+          const AlignedArray<int> &a = *e.purnoArray;
+          if (e.slot == REDUCE_SUM) return (double)sumArray(a.data(), a.size());
+          return e.slot == REDUCE_MIN ? minArray(a.data(), a.size()) : maxArray(a.data(), a.size());
+        } else {
+          const AlignedArray<double> &a = *e.vognoArray;
+          if (e.slot == REDUCE_SUM) return sumArray(a.data(), a.size());
+          return e.slot == REDUCE_MIN ? minArray(a.data(), a.size()) : maxArray(a.data(), a.size());
+        }
+      case EXPR_BINARY: {
+        if (stackExhausted()) {  // long operator chains build deep trees
+          halt(RUN_DEPTH_LIMIT);
+          return 0;
+        }
+        double a = eval(fn, e.left, fp);
+        double b = eval(fn, e.right, fp);
+        switch ((BinaryOp)e.slot) {
+          case OP_ADD: return a + b;
+          case OP_SUB: return a - b;
+          case OP_MUL: return a * b;
+          case OP_DIV:
+            if (b == 0) {
+              err << "Error: Division by zero" << endl;
+              return 0;
+            }
+            return a / b;
+          case OP_LT: return a < b ? 1 : 0;
+          case OP_GT: return a > b ? 1 : 0;
+          case OP_LE: return a <= b ? 1 : 0;
+          case OP_GE: return a >= b ? 1 : 0;
+          case OP_EQ: return a == b ? 1 : 0;
+          case OP_NE: return a != b ? 1 : 0;
+          case OP_AND: return (a != 0 && b != 0) ? 1 : 0;
+          case OP_OR: return (a != 0 || b != 0) ? 1 : 0;
+        }
+        return 0;
+      }
+      case EXPR_CALL: {
+        const Function &callee = *functions[e.slot];
+        if (!callable(callee, e.args.size())) return 0;
+        size_t frame = pushFrame(callee);
+        for (size_t i = 0; i < e.args.size(); i++) setArg(callee, frame, (int)i, eval(fn, e.args[i], fp));
+        return runFrame(callee, frame);
+      }
+    }
+    return 0;
+}
+
+bool Parser::elementIndex(const Function& fn, const Expr& e, size_t fp, size_t& index) {
+    double v = eval(fn, e.left, fp);
+    size_t size = e.purnoArray ? e.purnoArray->size() : e.vognoArray->size();
+    if (v != floor(v) || v < 0 || v >= size) {
+      err << "Error: Index " << v << " out of bounds for array '" << e.name << "' of size " << size << "." << endl;
+      return false;
+    }
+    index = (size_t)v;
+    return true;
+}
+
+void Parser::store(const Function& fn, int target, AssignOp op, double value, size_t fp) {
+    const Expr &e = fn.exprs[target];
+    size_t i;
+    switch (e.kind) {
+      case EXPR_LOCAL:
+        if (fn.slots[e.slot] == TYPE_PURNO) {
+          // Integer semantics through a temporary, the slot itself is a double
+          int v = (int)frames[fp + e.slot];
+          assignValue(v, op, value, "an integer variable", e.name, err);
+          frames[fp + e.slot] = v;
+        } else {
+          assignValue(frames[fp + e.slot], op, value, "", e.name, err);
+        }
+        break;
+      case EXPR_PURNO_GLOBAL:
+        assignValue(*e.purno, op, value, "an integer variable", e.name, err);
+        break;
+      case EXPR_VOGNO_GLOBAL:
+        assignValue(*e.vogno, op, value, "", e.name, err);
+        break;
+      case EXPR_PURNO_ELEMENT:
+        if (elementIndex(fn, e, fp, i))
+          assignValue((*e.purnoArray)[i], op, value, "an element of integer array", e.name, err);
+        break;
+      case EXPR_VOGNO_ELEMENT:
+        if (elementIndex(fn, e, fp, i)) assignValue((*e.vognoArray)[i], op, value, "", e.name, err);
+        break;
+      default:
+        break;
+    }
+}
+
+// Whether a value prints and reads as purno
+bool Parser::isWhole(const Function& fn, int index) {
+    const Expr &e = fn.exprs[index];
+    if (e.kind == EXPR_LOCAL) return fn.slots[e.slot] == TYPE_PURNO;
+    if (e.kind == EXPR_CALL) return functions[e.slot]->returnType == TYPE_PURNO;
+    if (e.kind == EXPR_REDUCE) return e.purnoArray != nullptr;
+    return e.kind == EXPR_PURNO_GLOBAL || e.kind == EXPR_PURNO_ELEMENT;
+}
@@ -0,0 +1,111 @@
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
+#include "arrays.h"
+#include <bits/stdc++.h>
+using namespace std;
+
+// Compiled form of kaj (function) bodies. A body is compiled once, when its
+// definition is reached, into flat expression and statement pools. Locals
+// and parameters become slot numbers in a frame on Parser's call stack.
+
+enum ValueType { TYPE_NONE, TYPE_PURNO, TYPE_VOGNO };
+
+enum ExprKind {
+  EXPR_CONST,
+  EXPR_LOCAL,          // frame slot
+  EXPR_PURNO_GLOBAL,   // variable declared outside any function
+  EXPR_VOGNO_GLOBAL,
+  EXPR_PURNO_ELEMENT,  // element of a global array, 'left' is the index
+  EXPR_VOGNO_ELEMENT,
+  EXPR_REDUCE,         // jogfol, choto or boro of a global array
+  EXPR_BINARY,
+  EXPR_CALL
+};
+
+enum BinaryOp { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ, OP_NE, OP_AND, OP_OR };
+
+enum ReduceOp { REDUCE_SUM, REDUCE_MIN, REDUCE_MAX };
+
+struct Expr {
+  ExprKind kind = EXPR_CONST;
+  double value = 0;          // EXPR_CONST
+  int slot = 0;              // local slot, callee index, BinaryOp or ReduceOp
+  int left = -1, right = -1;
+  int *purno = nullptr;      // globals are bound by address when the body is compiled
+  double *vogno = nullptr;
+  AlignedArray<int> *purnoArray = nullptr;
+  AlignedArray<double> *vognoArray = nullptr;
+  vector<int> args;          // EXPR_CALL
+  string name;               // variable, array or callee name for runtime errors
+};
+
+enum StmtKind { STMT_ASSIGN, STMT_IF, STMT_WHILE, STMT_RETURN, STMT_PRINT, STMT_INPUT, STMT_CALL };
+
+enum AssignOp { ASSIGN_SET, ASSIGN_ADD, ASSIGN_SUB, ASSIGN_MUL, ASSIGN_DIV, ASSIGN_INC, ASSIGN_DEC };
+
+// Operator for "=", "+=", "-=", "*=", "/=", "++" or "--"; false for anything else
+bool assignOpFor(const string &op, AssignOp &result);
+
+// Assignment rules shared by the interpreter and compiled bodies: purno
+// targets only take whole numbers from '=', compound operators truncate.
+// 'what' describes an integer target in the type-mismatch error.
+template <typename T>
+void assignValue(T &target, AssignOp op, double value, const char *what, const string &name, ostream &err) {
+  switch (op) {
+    case ASSIGN_SET:
+      if (is_integral<T>::value && value != floor(value))
+        err << "Error: Type mismatch. Cannot assign a non-integer value to " << what << " '" << name << "'." << endl;
+      else
+        target = value;
+      break;
+    case ASSIGN_ADD: target += value; break;
+    case ASSIGN_SUB: target -= value; break;
+    case ASSIGN_MUL: target *= value; break;
+    case ASSIGN_DIV:
+      if (value == 0) err << "Error: Division by zero." << endl;
+      else target /= value;
+      break;
+    case ASSIGN_INC: target++; break;
+    case ASSIGN_DEC: target--; break;
+  }
+}
+
+// One dekhao item: fixed text, a global shobdo variable, or a value
+struct PrintItem {
+  string text;
+  const string *shobdo = nullptr;
+  int expr = -1;
+};
+
+struct Stmt {
+  StmtKind kind = STMT_CALL;
+  AssignOp op = ASSIGN_SET;
+  int target = -1;    // STMT_ASSIGN
+  int expr = -1;      // assigned value, loop condition, returned value or call; -1 for none
+  vector<int> body;   // STMT_WHILE
+  vector<pair<int, vector<int>>> branches;  // STMT_IF: condition (-1 for nahole) and block
+  vector<PrintItem> items;  // STMT_PRINT
+  vector<int> targets;      // STMT_INPUT
+};
+
+// How a compiled block finished
+enum ExecResult { EXEC_NEXT, EXEC_RETURN, EXEC_HALT };
+
+struct Function {
+  string name;
+  ValueType returnType = TYPE_NONE;
+  int params = 0;
+  vector<ValueType> slots;  // parameters first, then locals in declaration order
+  vector<string> slotNames;
+  vector<Expr> exprs;
+  vector<Stmt> stmts;
+  vector<int> body;
+  int definedAt = -1;  // token position of 'kaj', -1 while only called from another body
+  bool valid = true;   // false once its body failed to compile
+};
+
+// Binding strength of a binary operator in expressions
+int operatorPrecedence(const string &op);
+
+#endif // FUNCTIONS_H
@@ -0,0 +1,161 @@
+#include "memstats.h"
+#include <bits/stdc++.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Every block carries its size and the phase that allocated it in a header,
+// so a free is charged to the allocating phase
+static const size_t HEADER_SIZE = 16;
+static const int UNCOUNTED = -1;  // allocated while stats were disabled
+// Re-read peak RSS once a phase's live high-water mark has grown this much
+static const long long RSS_SAMPLE_STEP = 1 << 20;
+
+static const char *phaseNames[PHASE_COUNT] = {"startup", "lex", "parse", "execute"};
+
+struct PhaseCounters {
+  atomic<long long> allocs;
+  atomic<long long> frees;
+  atomic<long long> bytes;
+  atomic<long long> peakLive;
+  atomic<long long> sampledLive;   // peakLive at the last RSS sample
+  atomic<long> peakRssKb;
+};
+
+static atomic<bool> enabled(false);
+static atomic<long long> liveBytes(0);
+static PhaseCounters counters[PHASE_COUNT];
+static thread_local MemPhase currentPhase = PHASE_STARTUP;
+
+static void raiseTo(atomic<long long> &target, long long value) {
+  long long seen = target.load(memory_order_relaxed);
+  while (value > seen && !target.compare_exchange_weak(seen, value, memory_order_relaxed)) {
+  }
+}
+
+static void *countedAlloc(size_t n) {
+  char *base = (char *)malloc(n + HEADER_SIZE);
+  if (!base) return nullptr;
+  *(size_t *)base = n;
+  int *phase = (int *)(base + sizeof(size_t));
+  *phase = UNCOUNTED;
+  if (enabled.load(memory_order_relaxed)) {
+    *phase = currentPhase;
+    PhaseCounters &c = counters[currentPhase];
+    c.allocs.fetch_add(1, memory_order_relaxed);
+    c.bytes.fetch_add(n, memory_order_relaxed);
+    long long live = liveBytes.fetch_add(n, memory_order_relaxed) + n;
+    raiseTo(c.peakLive, live);
+  }
+  return base + HEADER_SIZE;
+}
+
+static void countedFree(void *p) {
+  if (!p) return;
+  char *base = (char *)p - HEADER_SIZE;
+  int phase = *(int *)(base + sizeof(size_t));
+  if (phase != UNCOUNTED) {
+    counters[phase].frees.fetch_add(1, memory_order_relaxed);
+    liveBytes.fetch_sub(*(size_t *)base, memory_order_relaxed);
+  }
+  free(base);
+}
+
+void *operator new(size_t n) {
+  void *p = countedAlloc(n);
+  if (!p) throw bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t n) {
+  void *p = countedAlloc(n);
+  if (!p) throw bad_alloc();
+  return p;
+}
+
+void *operator new(size_t n, const nothrow_t &) noexcept { return countedAlloc(n); }
+void *operator new[](size_t n, const nothrow_t &) noexcept { return countedAlloc(n); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, const nothrow_t &) noexcept { countedFree(p); }
+void operator delete[](void *p, const nothrow_t &) noexcept { countedFree(p); }
+
+// Process peak resident set size (VmHWM) in KB, 0 where unavailable
+long readPeakRssKb() {
+#ifdef __linux__
+  int fd = open("/proc/self/status", O_RDONLY);
+  if (fd < 0) return 0;
+  char buf[4096];
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0) return 0;
+  buf[n] = '\0';
+  const char *line = strstr(buf, "VmHWM:");
+  return line ? atol(line + 6) : 0;
+#else
+  return 0;
+#endif
+}
+
+MemPhaseScope::MemPhaseScope(MemPhase phase) : saved(currentPhase) {
+  currentPhase = phase;
+}
+
+MemPhaseScope::~MemPhaseScope() {
+  if (enabled.load(memory_order_relaxed)) {
+    PhaseCounters &c = counters[currentPhase];
+    long long peak = c.peakLive.load(memory_order_relaxed);
+    if (c.peakRssKb.load(memory_order_relaxed) == 0 ||
+        peak - c.sampledLive.load(memory_order_relaxed) >= RSS_SAMPLE_STEP) {
+      c.sampledLive.store(peak, memory_order_relaxed);
+      c.peakRssKb.store(readPeakRssKb(), memory_order_relaxed);
+    }
+  }
+  currentPhase = saved;
+}
+
+void enableMemStats() {
+  enabled.store(true);
+}
+
+void printMemStats(ostream &os, bool json) {
+  // Snapshot before formatting, which allocates itself
+  enabled.store(false);
+  long peakRss = readPeakRssKb();
+  counters[currentPhase].peakRssKb.store(peakRss);
+  long long snap[PHASE_COUNT][5];
+  long rss[PHASE_COUNT];
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    snap[i][0] = counters[i].allocs;
+    snap[i][1] = counters[i].frees;
+    snap[i][2] = counters[i].bytes;
+    snap[i][3] = counters[i].peakLive;
+    rss[i] = counters[i].peakRssKb;
+  }
+  long long live = liveBytes;
+
+  if (json) {
+    os << "{\"mem_stats\":{\"peak_rss_kb\":" << peakRss << ",\"live_bytes\":" << live << ",\"phases\":{";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+      if (i) os << ",";
+      os << "\"" << phaseNames[i] << "\":{\"allocs\":" << snap[i][0] << ",\"frees\":" << snap[i][1]
+         << ",\"bytes\":" << snap[i][2] << ",\"peak_live_bytes\":" << snap[i][3]
+         << ",\"peak_rss_kb\":" << rss[i] << "}";
+    }
+    os << "}}}" << endl;
+    return;
+  }
+
+  os << "Memory statistics" << endl;
+  os << left << setw(10) << "phase" << right << setw(14) << "allocs" << setw(14) << "frees"
+     << setw(16) << "bytes" << setw(16) << "peak live" << setw(14) << "peak RSS KB" << endl;
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    os << left << setw(10) << phaseNames[i] << right << setw(14) << snap[i][0] << setw(14) << snap[i][1]
+       << setw(16) << snap[i][2] << setw(16) << snap[i][3] << setw(14) << rss[i] << endl;
+  }
+  os << "Live bytes at exit: " << live << endl;
+  os << "Process peak RSS: " << peakRss << " KB" << endl;
+}
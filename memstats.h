@@ -0,0 +1,29 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Pipeline phases that allocations are attributed to
+enum MemPhase {
+  PHASE_STARTUP,   // driver setup, argument and file handling
+  PHASE_LEX,       // reading chunks, comment stripping, tokenizing
+  PHASE_PARSE,     // buffering tokens into the parser window
+  PHASE_EXECUTE,   // running statements, symbol tables, expression evaluation
+  PHASE_COUNT
+};
+
+// Attributes allocations on this thread to 'phase' until it goes out of scope
+class MemPhaseScope {
+  MemPhase saved;
+
+ public:
+  explicit MemPhaseScope(MemPhase phase);
+  ~MemPhaseScope();
+};
+
+void enableMemStats();
+long readPeakRssKb();
+void printMemStats(ostream &os, bool json);
+
+#endif // MEMSTATS_H
@@ -1,41 +1,228 @@
 #include "parser.h"
 #include "tokenizer.h"
+#include "memstats.h"
 #include <bits/stdc++.h>
+#ifdef __linux__
+#include <pthread.h>
+#endif
 using namespace std;
 
-Parser::Parser(vector<Token> tks) : tokens(tks) {}
+// How many steps may pass between wall-clock and cancellation checks
+static const long long TIME_CHECK_INTERVAL = 1024;
+
+int LimitedOutputBuf::overflow(int c) {
+    if (c == traits_type::eof()) return traits_type::not_eof(c);
+    char ch = (char)c;
+    xsputn(&ch, 1);
+    return c;
+}
+
+streamsize LimitedOutputBuf::xsputn(const char *s, streamsize n) {
+    if (cap > 0 && written + n > cap) {
+      overflowed = true;
+      n = max<streamsize>(0, cap - written);
+    }
+    written += n;
+    if (n > 0) sink->sputn(s, n);
+    return n;
+}
+
+int LimitedOutputBuf::sync() {
+    return sink->pubsync();
+}
+
+// Half of the calling thread's stack, which is what nested blocks, expressions
+// and kaj calls may use. --max-depth alone cannot keep a deep recursion, or a
+// deeply nested program, from overflowing a main or worker thread stack.
+static size_t callStackBudget() {
+    size_t size = 0;
+#ifdef __linux__
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+      pthread_attr_getstacksize(&attr, &size);
+      pthread_attr_destroy(&attr);
+    }
+#endif
+    return size > 0 ? size / 2 : 1 << 20;
+}
+
+// Tokens already consumed at top level are dropped once the window grows past this
+static const int WINDOW_TOKENS = 4096;
+
+Parser::Parser(vector<Token> tks, istream &input, ostream &output, ostream &errors)
+    : window(std::move(tks)), windowMatch(window.size(), -1), tokens(window), braceMatch(windowMatch),
+      in(input), err(errors), outBuf(output.rdbuf()) {
+    for (int i = 0; i < (int)tokens.size(); i++) matchBrace(i);
+    reportUnclosedBraces();
+}
+
+Parser::Parser(Lexer &lx, istream &input, ostream &output, ostream &errors)
+    : lexer(&lx), tokens(window), braceMatch(windowMatch),
+      in(input), err(errors), outBuf(output.rdbuf()) {}
+
+Parser::Parser(shared_ptr<const Program> prog, istream &input, ostream &output, ostream &errors)
+    : program(prog), tokens(prog->tokens), braceMatch(prog->braceMatch),
+      in(input), err(errors), outBuf(output.rdbuf()) {
+    err << prog->diagnostics;
+}
+
+// Lex the whole source and build its brace table, collecting diagnostics
+// instead of printing them so every run of the program can replay them
+shared_ptr<const Program> Parser::compile(const string &source) {
+    ostringstream diagnostics;
+    vector<Token> tks = tokenizeParallel(source, thread::hardware_concurrency(), diagnostics);
+    Parser compiler(std::move(tks), cin, cout, diagnostics);
+
+    shared_ptr<Program> prog = make_shared<Program>();
+    prog->tokens.swap(compiler.window);
+    prog->braceMatch.swap(compiler.windowMatch);
+    prog->diagnostics = diagnostics.str();
+
+    size_t inlineChars = string().capacity();  // short strings live inside the Token
+    prog->bytes = sizeof(Program) + prog->tokens.capacity() * sizeof(Token) +
+                  prog->braceMatch.capacity() * sizeof(int) + prog->diagnostics.capacity();
+    for (const Token &t : prog->tokens)
+      if (t.value.capacity() > inlineChars) prog->bytes += t.value.capacity() + 1;
+    return prog;
+}
+
+// Record the token at absolute position 'index' in the brace jump table
+void Parser::matchBrace(int index) {
+    const Token &t = tokens[index - base];
+    if (t.type != "BRACE") return;
+    if (t.value == "{") {
+      openBraces.push_back(make_pair(index, t.line));
+    } else if (openBraces.empty()) {
+      err << "Error: Unmatched '}' at line " << t.line << "." << endl;
+    } else {
+      int open = openBraces.back().first;
+      openBraces.pop_back();
+      if (open >= base) windowMatch[open - base] = index;
+      windowMatch[index - base] = open;
+    }
+}
+
+void Parser::reportUnclosedBraces() {
+    for (const auto &open : openBraces) {
+      err << "Error: Unclosed '{' at line " << open.second << "." << endl;
+    }
+    openBraces.clear();
+}
+
+// Absolute position of the '}' matching the '{' at 'open', -1 if it has none
+int Parser::closingBrace(int open) {
+    while (braceMatch[open - base] < 0 && fill(base + (int)tokens.size())) {
+    }
+    return braceMatch[open - base];
+}
+
+// Make sure the token at absolute position 'index' is in the window
+bool Parser::fill(int index) {
+    if (index < base + (int)tokens.size()) return true;
+    MemPhaseScope phase(PHASE_PARSE);
+    while (lexer && base + (int)tokens.size() <= index) {
+      Token t = lexer->next();
+      if (t.type == "EOF") {
+        lexer = nullptr;
+        reportUnclosedBraces();
+        break;
+      }
+      window.push_back(std::move(t));
+      windowMatch.push_back(-1);
+      matchBrace(base + (int)tokens.size() - 1);
+    }
+    return index < base + (int)tokens.size();
+}
+
+// Drop tokens before the current position while streaming. Only safe between top-level
+// statements, since loops jump back to their condition. A Parser built from a token list
+// already holds the whole program; erasing from its front after every statement made
+// runs quadratic in program length, so those windows are never trimmed.
+void Parser::release() {
+    if (!lexer || pos - base < WINDOW_TOKENS) return;
+    window.erase(window.begin(), window.begin() + (pos - base));
+    windowMatch.erase(windowMatch.begin(), windowMatch.begin() + (pos - base));
+    base = pos;
+}
+
+// Slow path of tick(): runs every TIME_CHECK_INTERVAL steps, or once the step cap is due
+bool Parser::checkLimits() {
+    if (status != RUN_OK) return false;
+    if (limits.maxSteps > 0 && steps > limits.maxSteps) {
+      halt(RUN_STEP_LIMIT);
+      return false;
+    }
+    if (limits.timeLimitMs > 0 && chrono::steady_clock::now() >= deadline) {
+      halt(RUN_TIME_LIMIT);
+      return false;
+    }
+    if (cancel && cancel->load(memory_order_relaxed)) {
+      halt(RUN_CANCELLED);
+      return false;
+    }
+    nextCheck = steps + TIME_CHECK_INTERVAL;
+    if (limits.timeLimitMs <= 0 && !cancel) nextCheck = LLONG_MAX;
+    if (limits.maxSteps > 0) nextCheck = min(nextCheck, limits.maxSteps + 1);
+    return true;
+}
+
+// Stop execution; statement and loop boundaries unwind once status is set
+void Parser::halt(RunStatus reason) {
+    if (status != RUN_OK) return;
+    status = reason;
+    nextCheck = 0;  // every later tick() takes the slow path and fails
+    out.flush();
+    if (reason == RUN_STEP_LIMIT)
+      err << "Error: Step limit of " << limits.maxSteps << " exceeded." << endl;
+    else if (reason == RUN_TIME_LIMIT)
+      err << "Error: Time limit of " << limits.timeLimitMs << " ms exceeded after " << steps << " steps." << endl;
+    else if (reason == RUN_OUTPUT_LIMIT)
+      err << "Error: Output limit of " << limits.maxOutputBytes << " bytes exceeded." << endl;
+    else if (reason == RUN_CANCELLED)
+      err << "Error: Run cancelled after " << steps << " steps." << endl;
+    else if (reason == RUN_DEPTH_LIMIT && callDepth >= limits.maxCallDepth)
+      err << "Error: Call depth limit of " << limits.maxCallDepth << " exceeded." << endl;
+    else if (reason == RUN_DEPTH_LIMIT)
+      err << "Error: Stack exhausted by nested blocks, expressions or calls (call depth " << callDepth << ")." << endl;
+}
 
 Token Parser::peek() {
-    if (pos < (int)tokens.size()) return tokens[pos];
-    return {"EOF", ""};
+    if (fill(pos)) return tokens[pos - base];
+    return {"EOF", "", 0};
 }
 
 Token Parser::get() {
-    if (pos < (int)tokens.size()) return tokens[pos++];
-    return {"EOF", ""};
+    if (fill(pos)) return tokens[pos++ - base];
+    return {"EOF", "", 0};
 }
 
 bool Parser::isDeclared(const string& varName) {
-    return purnoTable.count(varName) || vognoTable.count(varName) || shobdoTable.count(varName);
+    return purnoTable.count(varName) || vognoTable.count(varName) || shobdoTable.count(varName) ||
+           isArray(varName);
+}
+
+bool Parser::isArray(const string& varName) {
+    return purnoArrays.count(varName) || vognoArrays.count(varName);
+}
+
+// Skip the rest of the current statement after an error
+void Parser::skipStatement() {
+    while (peek().value != ";" && peek().type != "EOF") get();
+    if (peek().value == ";") get();
 }
 
 double Parser::parseExpression(const string& stopAt) {
+    if (stackExhausted()) {  // calls and indexes nest expressions
+      halt(RUN_DEPTH_LIMIT);
+      return 0;
+    }
     vector<string> output;
     stack<string> ops;
-
-    auto precedence = [](const string &op) {
-      if (op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" ||
-          op == "!=")
-        return 4;  // Comparison operators
-      if (op == "&&") return 3;  // Logical AND
-      if (op == "||") return 2;  // Logical OR
-      if (op == "+" || op == "-") return 1;
-      if (op == "*" || op == "/") return 1;
-      return 0;
-    };
+    vector<double> values;  // array elements, reductions and calls, evaluated while parsing
+    int depth = 0;          // open parentheses; a ')' inside them does not end the expression
 
     // Parse expression until we hit stopAt token or EOF
-    while (peek().type != "EOF" && (stopAt.empty() || peek().value != stopAt)) {
+    while (peek().type != "EOF" && (stopAt.empty() || peek().value != stopAt || depth > 0)) {
       Token t = peek();
       if (t.type == "PURNO_LITERAL" || t.type == "VOGNO_LITERAL" || t.type == "IDENTIFIER" ||
           (t.type == "OPERATOR" &&
@@ -43,24 +230,38 @@ double Parser::parseExpression(const string& stopAt) {
             t.value == "/" || t.value == "<" || t.value == ">" ||
             t.value == "<=" || t.value == ">=" || t.value == "==" ||
             t.value == "!=" || t.value == "&&" || t.value == "||")) ||
-          t.value == "(") {
+          t.value == "(" || (t.value == ")" && depth > 0)) {
         get();  // consume the token
 
         if (t.type == "PURNO_LITERAL" || t.type == "VOGNO_LITERAL")
           output.push_back(t.value);
-        else if (t.type == "IDENTIFIER")
+        else if (t.type == "IDENTIFIER" && peek().value == "(" && !isDeclared(t.value)) {
+          // Built-in reductions and kaj calls are evaluated right away too
+          values.push_back(isArrayReduction(t.value) ? parseArrayReduction(t.value) : parseCall(t.value, true));
+          output.push_back("#" + to_string(values.size() - 1));
+        } else if (t.type == "IDENTIFIER" && peek().value == "[" && isArray(t.value)) {
+          // Array elements are read right away; '#k' refers to values[k]
+          size_t index;
+          double v = 0;
+          if (parseIndex(t.value, index))
+            v = purnoArrays.count(t.value) ? purnoArrays.at(t.value)[index] : vognoArrays.at(t.value)[index];
+          values.push_back(v);
+          output.push_back("#" + to_string(values.size() - 1));
+        } else if (t.type == "IDENTIFIER")
           output.push_back("@" + t.value);
-        else if (t.value == "(")
+        else if (t.value == "(") {
           ops.push(t.value);
-        else if (t.value == ")") {
+          depth++;
+        } else if (t.value == ")") {
           while (!ops.empty() && ops.top() != "(") {
             output.push_back(ops.top());
             ops.pop();
           }
           if (!ops.empty()) ops.pop();  // remove the '('
+          depth--;
         } else if (t.type == "OPERATOR") {
           while (!ops.empty() && ops.top() != "(" &&
-                 precedence(ops.top()) >= precedence(t.value)) {
+                 operatorPrecedence(ops.top()) >= operatorPrecedence(t.value)) {
             output.push_back(ops.top());
             ops.pop();
           }
@@ -72,7 +273,7 @@ double Parser::parseExpression(const string& stopAt) {
     }
 
     while (!ops.empty()) {
-      output.push_back(ops.top());
+      if (ops.top() != "(") output.push_back(ops.top());
       ops.pop();
     }
 
@@ -85,15 +286,20 @@ double Parser::parseExpression(const string& stopAt) {
           st.push(purnoTable[var]);
         } else if (vognoTable.count(var)) {
           st.push(vognoTable[var]);
+        } else if (isArray(var)) {
+          err << "Error: Array '" << var << "' used without an index." << endl;
+          return 0;
         } else {
-          cerr << "Error: Undeclared variable '" << var << "' used in expression." << endl;
+          err << "Error: Undeclared variable '" << var << "' used in expression." << endl;
           return 0;
         }
+      } else if (tok[0] == '#') {
+        st.push(values[stoi(tok.substr(1))]);
       } else if (isNumber(tok)) {
         st.push(stod(tok));
       } else {
         if (st.size() < 2) {
-          cerr << "Error: Invalid expression" << endl;
+          err << "Error: Invalid expression" << endl;
           return 0;
         }
         double b = st.top();
@@ -108,7 +314,7 @@ double Parser::parseExpression(const string& stopAt) {
           st.push(a * b);
         else if (tok == "/") {
           if (b == 0) {
-            cerr << "Error: Division by zero" << endl;
+            err << "Error: Division by zero" << endl;
             return 0;
           }
           st.push(a / b);
@@ -147,26 +353,217 @@ string Parser::parseStringExpression() {
         }
         else {
             // Invalid token in string expression
-            cerr << "Error: Invalid token in string expression" << endl;
+            err << "Error: Invalid token in string expression" << endl;
             break;
         }
     }
     return result;
 }
 
+void Parser::declareArray(const string& type, const string& var) {
+    get();  // consume '['
+    double size = parseExpression("]");
+    if (peek().value != "]") {
+      err << "Error: Expected ']' in declaration of array '" << var << "'." << endl;
+      return;
+    }
+    get();  // consume ']'
+
+    if (isDeclared(var)) {
+      err << "Error: Redeclaration of variable '" << var << "'." << endl;
+    } else if (isFunction(var)) {
+      err << "Error: '" << var << "' is already declared as a function." << endl;
+    } else if (type == "shobdo") {
+      err << "Error: Arrays of type 'shobdo' are not supported." << endl;
+    } else if (size != floor(size) || size < 1 || size > MAX_ARRAY_SIZE) {
+      err << "Error: Invalid size " << size << " for array '" << var << "'." << endl;
+    } else if (type == "purno") {
+      purnoArrays.emplace(var, AlignedArray<int>((size_t)size));
+    } else {
+      vognoArrays.emplace(var, AlignedArray<double>((size_t)size));
+    }
+
+    if (peek().value == "=") {
+      err << "Error: Array '" << var << "' cannot be initialized in its declaration; use bhoro." << endl;
+      while (peek().value != ";" && peek().value != "," && peek().type != "EOF") get();
+    }
+}
+
+// Parse '[expr]' after an array name and bounds-check the result
+bool Parser::parseIndex(const string& var, size_t& index) {
+    get();  // consume '['
+    double v = parseExpression("]");
+    if (status != RUN_OK) return false;
+    if (peek().value != "]") {
+      err << "Error: Expected ']' after index of array '" << var << "'." << endl;
+      return false;
+    }
+    get();  // consume ']'
+
+    size_t size = purnoArrays.count(var) ? purnoArrays.at(var).size() : vognoArrays.at(var).size();
+    if (v != floor(v) || v < 0 || v >= size) {
+      err << "Error: Index " << v << " out of bounds for array '" << var << "' of size " << size << "." << endl;
+      return false;
+    }
+    index = (size_t)v;
+    return true;
+}
+
+void Parser::parseElementAssignment(const string& var) {
+    size_t index;
+    bool valid = parseIndex(var, index);
+    string op = get().value;
+    AssignOp kind;
+    if (assignOpFor(op, kind)) {
+      double result = kind == ASSIGN_INC || kind == ASSIGN_DEC ? 0 : parseExpression();
+      if (valid) {
+        if (purnoArrays.count(var))
+          assignValue(purnoArrays.at(var)[index], kind, result, "an element of integer array", var, err);
+        else
+          assignValue(vognoArrays.at(var)[index], kind, result, "", var, err);
+      }
+    } else {
+      err << "Error: Invalid operation '" << op << "' for array element '" << var << "'." << endl;
+    }
+    if (peek().value == ";") get();
+}
+
+// bhoro(a, x), jog(a, x or b) and gun(a, x or b) over a whole array
+void Parser::parseArrayStatement(const string& name) {
+    if (peek().value != "(") {
+      err << "Error: Expected '(' after '" << name << "'." << endl;
+      skipStatement();
+      return;
+    }
+    get();  // '('
+    string var = get().value;
+    if (!isArray(var)) {
+      err << "Error: '" << var << "' is not an array." << endl;
+      skipStatement();
+      return;
+    }
+    if (peek().value != ",") {
+      err << "Error: Expected ',' after '" << var << "' in '" << name << "'." << endl;
+      skipStatement();
+      return;
+    }
+    get();  // ','
+
+    // The second argument is another array unless it is an indexed element
+    string other = peek().value;
+    bool withArray = name != "bhoro" && peek().type == "IDENTIFIER" && isArray(other) &&
+                     fill(pos + 1) && tokens[pos + 1 - base].value != "[";
+    double scalar = 0;
+    if (withArray) get();
+    else scalar = parseExpression(")");
+
+    if (peek().value != ")") {
+      err << "Error: Expected ')' after arguments of '" << name << "'." << endl;
+      skipStatement();
+      return;
+    }
+    get();  // ')'
+    if (peek().value == ";") get();
+
+    bool targetPurno = purnoArrays.count(var) > 0;
+    size_t n = targetPurno ? purnoArrays.at(var).size() : vognoArrays.at(var).size();
+
+    if (!withArray) {
+      if (targetPurno && scalar != floor(scalar)) {
+        err << "Error: Type mismatch. Cannot use a non-integer value with integer array '" << var << "'." << endl;
+        return;
+      }
+      if (targetPurno) {
+        int *a = purnoArrays.at(var).data();
+        if (name == "bhoro") fillArray(a, n, (int)scalar);
+        else if (name == "jog") addScalar(a, n, (int)scalar);
+        else mulScalar(a, n, (int)scalar);
+      } else {
+        double *a = vognoArrays.at(var).data();
+        if (name == "bhoro") fillArray(a, n, scalar);
+        else if (name == "jog") addScalar(a, n, scalar);
+        else mulScalar(a, n, scalar);
+      }
+      return;
+    }
+
+    bool sourcePurno = purnoArrays.count(other) > 0;
+    size_t m = sourcePurno ? purnoArrays.at(other).size() : vognoArrays.at(other).size();
+    if (n != m) {
+      err << "Error: Array size mismatch in '" << name << "': '" << var << "' has " << n
+          << " elements, '" << other << "' has " << m << "." << endl;
+      return;
+    }
+    if (targetPurno && !sourcePurno) {
+      err << "Error: Type mismatch. Cannot combine vogno array '" << other << "' into integer array '" << var << "'." << endl;
+      return;
+    }
+    if (targetPurno) {
+      int *a = purnoArrays.at(var).data();
+      const int *b = purnoArrays.at(other).data();
+      if (name == "jog") addArray(a, b, n);
+      else mulArray(a, b, n);
+    } else if (sourcePurno) {
+      double *a = vognoArrays.at(var).data();
+      const int *b = purnoArrays.at(other).data();
+      if (name == "jog") addArray(a, b, n);
+      else mulArray(a, b, n);
+    } else {
+      double *a = vognoArrays.at(var).data();
+      const double *b = vognoArrays.at(other).data();
+      if (name == "jog") addArray(a, b, n);
+      else mulArray(a, b, n);
+    }
+}
+
+// jogfol(a), choto(a) and boro(a) inside an expression
+double Parser::parseArrayReduction(const string& name) {
+    if (peek().value != "(") {
+      err << "Error: Expected '(' after '" << name << "'." << endl;
+      return 0;
+    }
+    get();  // '('
+    string var = get().value;
+    if (peek().value != ")") {
+      err << "Error: Expected ')' after '" << var << "' in '" << name << "'." << endl;
+      return 0;
+    }
+    get();  // ')'
+
+    if (purnoArrays.count(var)) {
+      const AlignedArray<int> &a = purnoArrays.at(var);
+      if (name == "jogfol") return (double)sumArray(a.data(), a.size());
+      if (name == "choto") return minArray(a.data(), a.size());
+      return maxArray(a.data(), a.size());
+    }
+    if (vognoArrays.count(var)) {
+      const AlignedArray<double> &a = vognoArrays.at(var);
+      if (name == "jogfol") return sumArray(a.data(), a.size());
+      if (name == "choto") return minArray(a.data(), a.size());
+      return maxArray(a.data(), a.size());
+    }
+    err << "Error: '" << var << "' is not an array." << endl;
+    return 0;
+}
+
 void Parser::parseBlock() {
     get(); // consume '{'
-    while (peek().value != "}" && peek().type != "EOF") {
+    while (status == RUN_OK && peek().value != "}" && peek().type != "EOF") {
       parseStatement();
     }
     if (peek().value == "}") get();  // consume '}'
 }
 
 void Parser::parseStatement() {
+    if (!tick()) return;
+    if (stackExhausted()) {
+      halt(RUN_DEPTH_LIMIT);
+      return;
+    }
     Token t = peek(); // Use peek to check the token without consuming
     if (t.type == "OPERATOR") {
         get(); // Consume the invalid token
-        cerr << "Error: Invalid statement. Statements cannot start with an operator." << endl;
+        err << "Error: Invalid statement. Statements cannot start with an operator." << endl;
         // Skip to the end of the line to attempt recovery
         while(peek().value != ";" && peek().type != "EOF") get();
         if(peek().value == ";") get();
@@ -174,7 +571,7 @@ void Parser::parseStatement() {
     }
     if (t.type == "BRACE") {
         // Braces should be handled by parseBlock, not as statements
-        cerr << "Error: Unexpected brace '" << t.value << "'." << endl;
+        err << "Error: Unexpected brace '" << t.value << "'." << endl;
         get(); // consume the brace
         return;
     }
@@ -184,8 +581,16 @@ void Parser::parseStatement() {
       string type = t.value;
       do {
         string var = get().value;
+        if (peek().value == "[") {
+          declareArray(type, var);
+          continue;
+        }
+        bool isFunctionName = false;
         if (isDeclared(var)) {
-          cerr << "Error: Redeclaration of variable '" << var << "'." << endl;
+          err << "Error: Redeclaration of variable '" << var << "'." << endl;
+        } else if (isFunction(var)) {
+          err << "Error: '" << var << "' is already declared as a function." << endl;
+          isFunctionName = true;
         } else {
           if (type == "purno") purnoTable[var] = 0;
           else if (type == "vogno") vognoTable[var] = 0.0;
@@ -193,13 +598,12 @@ void Parser::parseStatement() {
         }
         if (peek().value == "=") {
             get(); // consume '='
-            if (type == "purno") {
-                double result = parseExpression();
-                if (result != floor(result)) {
-                    cerr << "Error: Type mismatch. Cannot assign a non-integer value to an integer variable '" << var << "'." << endl;
-                } else {
-                    purnoTable[var] = static_cast<int>(result);
-                }
+            if (isFunctionName) {
+                // Evaluate to consume the initializer, but do not create the variable
+                if (type == "shobdo") parseStringExpression();
+                else parseExpression();
+            } else if (type == "purno") {
+                assignValue(purnoTable[var], ASSIGN_SET, parseExpression(), "an integer variable", var, err);
             } else if (type == "vogno") {
                 vognoTable[var] = parseExpression();
             } else if (type == "shobdo") {
@@ -210,7 +614,7 @@ void Parser::parseStatement() {
       // Semicolon is consumed by the loop
     } else if (t.value == "nao") {
         if (peek().value != ">>") {
-            cerr << "Error: Expected '>>' after 'nao'." << endl;
+            err << "Error: Expected '>>' after 'nao'." << endl;
             while(peek().value != ";" && peek().type != "EOF") get();
             if(peek().value == ";") get();
             return;
@@ -218,21 +622,26 @@ void Parser::parseStatement() {
         do {
             get(); // consume '>>'
             string var = get().value;
-            if (purnoTable.count(var)) {
-                cin >> purnoTable[var];
+            size_t index;
+            if (isArray(var) && peek().value == "[") {
+                if (!parseIndex(var, index)) continue;
+                if (purnoArrays.count(var)) in >> purnoArrays.at(var)[index];
+                else in >> vognoArrays.at(var)[index];
+            } else if (purnoTable.count(var)) {
+                in >> purnoTable[var];
             } else if (vognoTable.count(var)) {
-                cin >> vognoTable[var];
+                in >> vognoTable[var];
             } else if (shobdoTable.count(var)) {
-                cin >> shobdoTable[var];
+                in >> shobdoTable[var];
             } else {
-                cerr << "Error: Input to undeclared variable '" << var << "'." << endl;
+                err << "Error: Input to undeclared variable '" << var << "'." << endl;
             }
         } while (peek().value == ">>");
         if (peek().value == ";") get();  // consume ';'
     } 
     else if (t.value == "dekhao") {
         if (peek().value != "<<") {
-            cerr << "Error: Expected '<<' after 'dekhao'." << endl;
+            err << "Error: Expected '<<' after 'dekhao'." << endl;
             while(peek().value != ";" && peek().type != "EOF") get();
             if(peek().value == ";") get();
             return;
@@ -241,46 +650,91 @@ void Parser::parseStatement() {
         do {
             get(); // consume '<<'
             Token nxt = peek();
-            if (nxt.type == "STRING" || nxt.type == "IDENTIFIER" || nxt.type == "PURNO_LITERAL" || nxt.type == "VOGNO_LITERAL") {
+            if (nxt.type == "IDENTIFIER" && isArrayReduction(nxt.value) && !isDeclared(nxt.value) &&
+                fill(pos + 1) && tokens[pos + 1 - base].value == "(") {
+                get(); // consume reduction name
+                // Reductions of a purno array print as whole numbers, like purno variables
+                bool whole = fill(pos + 1) && purnoArrays.count(tokens[pos + 1 - base].value);
+                double v = parseArrayReduction(nxt.value);
+                if (whole) out << (long long)v;
+                else out << v;
+            } else if (nxt.type == "STRING" || nxt.type == "IDENTIFIER" || nxt.type == "PURNO_LITERAL" || nxt.type == "VOGNO_LITERAL") {
                 get(); // consume value
                 // --- Printing logic ---
                 if (nxt.type == "STRING") {
                     string output = nxt.value;
                     for (size_t i = 0; i < output.length(); i++) {
                         if (output[i] == '\\' && i + 1 < output.length()) {
-                            if (output[i + 1] == 'n') { cout << '\n'; i++; }
-                            else if (output[i + 1] == 't') { cout << '\t'; i++; }
-                            else { cout << output[i]; }
-                        } else { cout << output[i]; }
+                            if (output[i + 1] == 'n') { out << '\n'; i++; }
+                            else if (output[i + 1] == 't') { out << '\t'; i++; }
+                            else { out << output[i]; }
+                        } else { out << output[i]; }
                     }
                 } else if (nxt.type == "IDENTIFIER") {
-                    if (purnoTable.count(nxt.value)) { cout << purnoTable[nxt.value]; }
-                    else if (vognoTable.count(nxt.value)) { cout << vognoTable[nxt.value]; }
-                    else if (shobdoTable.count(nxt.value)) { cout << shobdoTable[nxt.value]; }
-                    else { cerr << "Error: Undeclared variable '" << nxt.value << "'." << endl; }
+                    size_t index;
+                    if (peek().value == "(" && functionIndex.count(nxt.value)) {
+                        double v = parseCall(nxt.value, true);
+                        if (status != RUN_OK) return;
+                        if (functions[functionIndex[nxt.value]]->returnType == TYPE_PURNO) out << (int)v;
+                        else out << v;
+                    }
+                    else if (isArray(nxt.value) && peek().value == "[") {
+                        if (parseIndex(nxt.value, index)) {
+                            if (purnoArrays.count(nxt.value)) out << purnoArrays.at(nxt.value)[index];
+                            else out << vognoArrays.at(nxt.value)[index];
+                        }
+                    }
+                    else if (isArray(nxt.value)) { err << "Error: Array '" << nxt.value << "' used without an index." << endl; }
+                    else if (purnoTable.count(nxt.value)) { out << purnoTable[nxt.value]; }
+                    else if (vognoTable.count(nxt.value)) { out << vognoTable[nxt.value]; }
+                    else if (shobdoTable.count(nxt.value)) { out << shobdoTable[nxt.value]; }
+                    else { err << "Error: Undeclared variable '" << nxt.value << "'." << endl; }
                 } else { // PURNO_LITERAL or VOGNO_LITERAL
-                    cout << nxt.value;
+                    out << nxt.value;
                 }
             } else {
-                cerr << "Error: Expected a variable, string, or number after '<<', but got '" << nxt.value << "'." << endl;
+                err << "Error: Expected a variable, string, or number after '<<', but got '" << nxt.value << "'." << endl;
                 while(peek().value != ";" && peek().type != "EOF") get();
                 if(peek().value == ";") get();
                 return;
             }
+            if (outBuf.exceeded()) {
+                halt(RUN_OUTPUT_LIMIT);
+                return;
+            }
         } while (peek().value == "<<");
 
         if (peek().value == ";") {
             get();  // consume ';'
         } else {
-            cerr << "Error: Expected ';' at the end of the dekhao statement, but got '" << peek().value << "'." << endl;
+            err << "Error: Expected ';' at the end of the dekhao statement, but got '" << peek().value << "'." << endl;
             while(peek().value != ";" && peek().type != "EOF") get();
             if(peek().value == ";") get();
         }
     } else if (t.type == "IDENTIFIER") {
       // Handle assignments and increment/decrement
       string var = t.value;
+      if (startsDefinition(t)) {
+        defineFunction();
+        return;
+      }
+      if (startsReturn(t)) {
+        err << "Error: 'ferot' can only be used inside a function." << endl;
+        skipStatement();
+        return;
+      }
+      if (peek().value == "(" && !isDeclared(var)) {
+        if (isArrayStatement(var)) {
+          parseArrayStatement(var);
+          return;
+        }
+        if (isArrayReduction(var)) parseArrayReduction(var);
+        else parseCall(var, false);
+        if (peek().value == ";") get();
+        return;
+      }
       if (!isDeclared(var)) {
-        cerr << "Error: Undeclared variable '" << var << "'." << endl;
+        err << "Error: Undeclared variable '" << var << "'." << endl;
         // Skip the rest of the statement to avoid further errors
         while (peek().type != "EOF" && peek().value != ";") {
           get();
@@ -288,61 +742,38 @@ void Parser::parseStatement() {
         if (peek().value == ";") get();
         return;
       }
-      Token op = get();
-      if (op.value == "=") {
-        if (purnoTable.count(var)) {
-            double result = parseExpression();
-            if (result != floor(result)) {
-                cerr << "Error: Type mismatch. Cannot assign a non-integer value to an integer variable '" << var << "'." << endl;
-            } else {
-                purnoTable[var] = static_cast<int>(result);
-            }
-        } else if (vognoTable.count(var)) {
-            vognoTable[var] = parseExpression();
-        } else if (shobdoTable.count(var)) {
-            shobdoTable[var] = parseStringExpression();
+      if (isArray(var)) {
+        if (peek().value == "[") {
+          parseElementAssignment(var);
+        } else {
+          err << "Error: Array '" << var << "' used without an index." << endl;
+          skipStatement();
         }
-        if (peek().value == ";") get();
-      } else if (op.value == "+=" || op.value == "-=" || op.value == "*=" || op.value == "/=") {
-          if (purnoTable.count(var)) {
-              double result = parseExpression();
-              if (op.value == "+=") purnoTable[var] += result;
-              else if (op.value == "-=") purnoTable[var] -= result;
-              else if (op.value == "*=") purnoTable[var] *= result;
-              else if (op.value == "/=") {
-                  if (result == 0) cerr << "Error: Division by zero." << endl;
-                  else purnoTable[var] /= result;
-              }
-          } else if (vognoTable.count(var)) {
-              double result = parseExpression();
-              if (op.value == "+=") vognoTable[var] += result;
-              else if (op.value == "-=") vognoTable[var] -= result;
-              else if (op.value == "*=") vognoTable[var] *= result;
-              else if (op.value == "/=") {
-                  if (result == 0) cerr << "Error: Division by zero." << endl;
-                  else vognoTable[var] /= result;
-              }
-          } else if (shobdoTable.count(var) && op.value == "+=") {
-              shobdoTable[var] += parseStringExpression();
-          } else {
-              cerr << "Error: Invalid operation '" << op.value << "' for variable '" << var << "'." << endl;
-          }
-          if (peek().value == ";") get();
-      } else if (op.value == "++") {
-        if(purnoTable.count(var)) purnoTable[var]++;
-        else if(vognoTable.count(var)) vognoTable[var]++;
-        else cerr << "Error: Cannot increment non-numeric variable '" << var << "'." << endl;
-        if (peek().value == ";") get();
-      } else if (op.value == "--") {
-        if(purnoTable.count(var)) purnoTable[var]--;
-        else if(vognoTable.count(var)) vognoTable[var]--;
-        else cerr << "Error: Cannot decrement non-numeric variable '" << var << "'." << endl;
-        if (peek().value == ";") get();
+        return;
+      }
+      Token op = get();
+      AssignOp kind;
+      if (!assignOpFor(op.value, kind)) return;
+      if (purnoTable.count(var) || vognoTable.count(var)) {
+        double result = kind == ASSIGN_INC || kind == ASSIGN_DEC ? 0 : parseExpression();
+        if (purnoTable.count(var)) assignValue(purnoTable[var], kind, result, "an integer variable", var, err);
+        else assignValue(vognoTable[var], kind, result, "", var, err);
+      } else if (kind == ASSIGN_SET) {
+        shobdoTable[var] = parseStringExpression();
+      } else if (kind == ASSIGN_ADD) {
+        shobdoTable[var] += parseStringExpression();
+      } else if (kind == ASSIGN_INC) {
+        err << "Error: Cannot increment non-numeric variable '" << var << "'." << endl;
+      } else if (kind == ASSIGN_DEC) {
+        err << "Error: Cannot decrement non-numeric variable '" << var << "'." << endl;
+      } else {
+        err << "Error: Invalid operation '" << op.value << "' for variable '" << var << "'." << endl;
       }
+      if (peek().value == ";") get();
     } else if (t.value == "jodi") {
       string c = peek().value;
       if (c != "(") {
-        cerr << "Error: Expected '(' after 'jodi', but got '" << c << "'." << endl;
+        err << "Error: Expected '(' after 'jodi', but got '" << c << "'." << endl;
         while(peek().value != ";" && peek().type != "EOF") get();
         if(peek().value == ";") get();
         return;
@@ -351,10 +782,11 @@ void Parser::parseStatement() {
       
       // Use the merged parseExpression function with ')' as stop condition
       double cond = parseExpression(")");
+      if (status != RUN_OK) return;
 
       c = peek().value;
       if (c != ")") {
-        cerr << "Error: Expected ')' after jodi condition, but got '" << c << "'." << endl;
+        err << "Error: Expected ')' after jodi condition, but got '" << c << "'." << endl;
         while(peek().value != ";" && peek().type != "EOF") get();
         if(peek().value == ";") get();
         return;
@@ -362,7 +794,7 @@ void Parser::parseStatement() {
       get();  // ')'
       
       if (peek().value != "{") {
-        cerr << "Error: Expected '{' after jodi condition." << endl;
+        err << "Error: Expected '{' after jodi condition." << endl;
         return;
       }
 
@@ -383,21 +815,22 @@ void Parser::parseStatement() {
           get();  // consume 'jodi'
           
           if (peek().value != "(") {
-            cerr << "Error: Expected '(' after 'nahole jodi'." << endl;
+            err << "Error: Expected '(' after 'nahole jodi'." << endl;
             return;
           }
           get();  // '('
           
           double elsifCond = parseExpression(")");
+          if (status != RUN_OK) return;
           
           if (peek().value != ")") {
-            cerr << "Error: Expected ')' after nahole jodi condition." << endl;
+            err << "Error: Expected ')' after nahole jodi condition." << endl;
             return;
           }
           get();  // ')'
           
           if (peek().value != "{") {
-            cerr << "Error: Expected '{' after nahole jodi condition." << endl;
+            err << "Error: Expected '{' after nahole jodi condition." << endl;
             return;
           }
           
@@ -410,7 +843,7 @@ void Parser::parseStatement() {
         } else {
           // This is a regular else (nahole)
           if (peek().value != "{") {
-            cerr << "Error: Expected '{' after nahole." << endl;
+            err << "Error: Expected '{' after nahole." << endl;
             return;
           }
           
@@ -423,12 +856,12 @@ void Parser::parseStatement() {
         }
       }
     } else if (t.value == "nahole") {
-      cerr << "Error: 'nahole' can only be used after a 'jodi' statement." << endl;
+      err << "Error: 'nahole' can only be used after a 'jodi' statement." << endl;
       while(peek().value != ";" && peek().type != "EOF") get();
       if(peek().value == ";") get();
     } else if (t.value == "jotokkhon") {
       if (peek().value != "(") {
-        cerr << "Error: Expected '(' after 'jotokkhon'." << endl;
+        err << "Error: Expected '(' after 'jotokkhon'." << endl;
         return;
       }
       get();  // '('
@@ -436,15 +869,16 @@ void Parser::parseStatement() {
       // Store the starting position for condition re-evaluation
       int conditionStart = pos;
       double cond = parseExpression(")");
+      if (status != RUN_OK) return;
       
       if (peek().value != ")") {
-        cerr << "Error: Expected ')' after jotokkhon condition." << endl;
+        err << "Error: Expected ')' after jotokkhon condition." << endl;
         return;
       }
       get();  // ')'
       
       if (peek().value != "{") {
-        cerr << "Error: Expected '{' after jotokkhon condition." << endl;
+        err << "Error: Expected '{' after jotokkhon condition." << endl;
         return;
       }
       get(); // consume '{'
@@ -452,21 +886,15 @@ void Parser::parseStatement() {
       // Store the position at the start of the loop body (after '{')
       int loopBodyStart = pos;
       
-      // Find the end of the loop body by counting braces
-      int braceCount = 1;
-      int loopBodyEnd = pos;
-      while (braceCount > 0 && loopBodyEnd < tokens.size()) {
-        if (tokens[loopBodyEnd].value == "{") braceCount++;
-        else if (tokens[loopBodyEnd].value == "}") braceCount--;
-        loopBodyEnd++;
-      }
-      loopBodyEnd--; // Position before the closing '}'
+      // The closing '}' comes from the brace table; an unclosed body runs to EOF
+      int loopBodyEnd = closingBrace(loopBodyStart - 1);
+      if (loopBodyEnd < 0) loopBodyEnd = base + (int)tokens.size();
       
       // Execute the loop
-      while (cond != 0) {
+      while (cond != 0 && tick()) {
         // Execute the loop body
         pos = loopBodyStart;
-        while (pos < loopBodyEnd) {
+        while (pos < loopBodyEnd && status == RUN_OK) {
           parseStatement();
         }
         
@@ -482,38 +910,38 @@ void Parser::parseStatement() {
       
       // Position after the closing '}'
       pos = loopBodyEnd + 1;
-      
-      // Skip the loop body if we're not executing it anymore
-      if (cond == 0) {
-        pos = loopBodyStart;
-        skipBlock();  // Skip the { ... } block
-      }
     }
 }
 
+// Jump past the block starting at the current '{' using the brace table
 void Parser::skipBlock() {
-    get(); // consume '{'
-    int depth = 1;
-    while (depth > 0 && peek().type != "EOF") {
-      Token x = get();
-      if (x.value == "{")
-        depth++;
-      else if (x.value == "}")
-        depth--;
-    }
+    int close = closingBrace(pos);
+    pos = close >= 0 ? close + 1 : base + (int)tokens.size();
 }
 
-void Parser::run() {
+RunStatus Parser::run() {
+    MemPhaseScope phase(PHASE_EXECUTE);
+    char marker;
+    stackBase = &marker;
+    stackBudget = callStackBudget();
+    outBuf.setCap(limits.maxOutputBytes);
+    deadline = chrono::steady_clock::now() + chrono::milliseconds(limits.timeLimitMs);
+    steps = 0;
+    nextCheck = 0;  // first tick() computes the real threshold
+
     if (get().value != "shuru") {
-        cerr << "Error: Expected 'shuru' at the beginning of the program." << endl;
-        return;
+        err << "Error: Expected 'shuru' at the beginning of the program." << endl;
+        return status;
     }
 
-    while (peek().value != "shesh" && peek().type != "EOF") {
+    while (status == RUN_OK && peek().value != "shesh" && peek().type != "EOF") {
       parseStatement();
+      release();
     }
 
-    if (get().value != "shesh") {
-        cerr << "Error: Expected 'shesh' at the end of the program." << endl;
+    if (status == RUN_OK && get().value != "shesh") {
+        err << "Error: Expected 'shesh' at the end of the program." << endl;
     }
+    out.flush();
+    return status;
 }
@@ -2,16 +2,109 @@
 #define PARSER_H
 
 #include "tokenizer.h"
+#include "arrays.h"
+#include "functions.h"
 #include <bits/stdc++.h>
 using namespace std;
 
+// Resource limits for a single run; zero means unlimited
+struct ExecutionLimits {
+  long long maxSteps = 0;        // statements executed plus loop iterations
+  long long timeLimitMs = 0;     // wall-clock budget from the start of run()
+  long long maxOutputBytes = 0;  // bytes written by dekhao
+  int maxCallDepth = 1000;       // nested kaj calls; always enforced
+};
+
+// Outcome of Parser::run(), doubles as the process exit code
+enum RunStatus {
+  RUN_OK = 0,
+  RUN_STEP_LIMIT = 3,
+  RUN_TIME_LIMIT = 4,
+  RUN_OUTPUT_LIMIT = 5,
+  RUN_DEPTH_LIMIT = 6,
+  RUN_CANCELLED = 7
+};
+
+// Forwards program output to another stream buffer, counting bytes and
+// dropping everything past the cap
+class LimitedOutputBuf : public streambuf {
+  streambuf *sink;
+  long long written = 0;
+  long long cap = 0;
+  bool overflowed = false;
+
+ protected:
+  int overflow(int c) override;
+  streamsize xsputn(const char *s, streamsize n) override;
+  int sync() override;
+
+ public:
+  explicit LimitedOutputBuf(streambuf *target) : sink(target) {}
+  void setCap(long long bytes) { cap = bytes; }
+  bool exceeded() const { return overflowed; }
+};
+
+// Token stream with its brace jump table, compiled once and shared
+// read-only by any number of runs
+struct Program {
+  vector<Token> tokens;
+  vector<int> braceMatch;
+  string diagnostics;  // lexer and brace errors found while compiling
+  size_t bytes = 0;    // approximate memory held, for the server's cache budget
+};
+
 class Parser {
   unordered_map<string, int> purnoTable;
   unordered_map<string, double> vognoTable;
   unordered_map<string, string> shobdoTable;
-  vector<Token> tokens;
+  unordered_map<string, AlignedArray<int>> purnoArrays;
+  unordered_map<string, AlignedArray<double>> vognoArrays;
+  Lexer *lexer = nullptr;  // token source when streaming, null for a fixed token list
+  vector<Token> window;    // owned tokens when streaming or built from a token list
+  vector<int> windowMatch;
+  shared_ptr<const Program> program;  // keeps a compiled program alive while running
+  const vector<Token> &tokens;        // tokens starting at absolute index 'base'
+  const vector<int> &braceMatch;      // absolute index of the matching brace, -1 while unknown
+  int base = 0;
   int pos = 0;
+  vector<pair<int, int>> openBraces;  // unmatched '{' as (absolute index, line)
+
+  ExecutionLimits limits;
+  RunStatus status = RUN_OK;
+  long long steps = 0;
+  long long nextCheck = LLONG_MAX;  // step count at which limits are next checked
+  chrono::steady_clock::time_point deadline;
+  const atomic<bool> *cancel = nullptr;  // set by another thread to stop the run
+  istream &in;
+  ostream &err;
+  LimitedOutputBuf outBuf;
+  ostream out{&outBuf};
 
+  vector<unique_ptr<Function>> functions;
+  unordered_map<string, int> functionIndex;
+  vector<double> frames;  // slots of every active call, innermost frame last
+  size_t frameTop = 0;
+  int callDepth = 0;
+  const char *stackBase = nullptr;  // C++ stack position when run() started
+  size_t stackBudget = 0;           // bytes of C++ stack that nesting may use
+  double returned = 0;    // value of the last ferot
+  vector<unordered_map<string, int>> scopes;  // local name to slot while compiling a body
+
+  // halt() zeroes nextCheck, so the fast path need not test status
+  bool tick() { return ++steps < nextCheck || checkLimits(); }
+  // Nested blocks, expressions and calls recurse on the C++ stack. Checked where
+  // that recursion re-enters, so deep input halts the run instead of crashing it.
+  bool stackExhausted() const {
+    char marker;
+    return (size_t)(stackBase - &marker) > stackBudget;
+  }
+  bool checkLimits();
+  void halt(RunStatus reason);
+  bool fill(int index);
+  void matchBrace(int index);
+  void reportUnclosedBraces();
+  int closingBrace(int open);
+  void release();
   Token peek();
   Token get();
   double parseExpression(const string& stopAt = ""); // Unified expression parser with optional stop condition
@@ -19,11 +112,53 @@ class Parser {
   void parseBlock();
   void parseStatement();
   void skipBlock();
+  void skipStatement();
   bool isDeclared(const string& varName);
+  bool isArray(const string& varName);
+  void declareArray(const string& type, const string& var);
+  bool parseIndex(const string& var, size_t& index);
+  void parseElementAssignment(const string& var);
+  void parseArrayStatement(const string& name);
+  double parseArrayReduction(const string& name);
+
+  // Functions, in functions.cpp
+  void defineFunction();
+  void skipDefinition();
+  int functionSlot(const string& name);
+  bool isFunction(const string& name);
+  bool startsDefinition(const Token& t);
+  bool startsReturn(const Token& t);
+  void compileError(Function& fn, const string& message);
+  bool expect(Function& fn, const string& value, const string& context);
+  void compileBlock(Function& fn, vector<int>& into);
+  void compileStatement(Function& fn, vector<int>& into);
+  int compileExpression(Function& fn, const string& stopAt = "");
+  int localSlot(const string& name);
+  int compileOperand(Function& fn, const Token& t, bool needValue);
+  int compileCall(Function& fn, const string& name, bool needValue);
+  int compileTarget(Function& fn, const string& name);
+  int compileElement(Function& fn, const string& name);
+  int compileReduction(Function& fn, const string& name);
+  bool callable(const Function& callee, size_t args);
+  size_t pushFrame(const Function& callee);
+  void setArg(const Function& callee, size_t frame, int i, double value);
+  double runFrame(const Function& callee, size_t frame);
+  double parseCall(const string& name, bool needValue);
+  ExecResult exec(const Function& fn, const vector<int>& block, size_t fp);
+  double eval(const Function& fn, int index, size_t fp);
+  bool elementIndex(const Function& fn, const Expr& e, size_t fp, size_t& index);
+  void store(const Function& fn, int target, AssignOp op, double value, size_t fp);
+  bool isWhole(const Function& fn, int index);
 
  public:
-  Parser(vector<Token> tks);
-  void run();
+  Parser(vector<Token> tks, istream &input = cin, ostream &output = cout, ostream &errors = cerr);
+  explicit Parser(Lexer &lx, istream &input = cin, ostream &output = cout, ostream &errors = cerr);
+  explicit Parser(shared_ptr<const Program> prog, istream &input = cin, ostream &output = cout,
+                  ostream &errors = cerr);
+  static shared_ptr<const Program> compile(const string &source);
+  void setLimits(const ExecutionLimits &lim) { limits = lim; }
+  void setCancelFlag(const atomic<bool> *flag) { cancel = flag; }
+  RunStatus run();
 };
 
 #endif // PARSER_H
@@ -0,0 +1,55 @@
+#include "protocol.h"
+#include <bits/stdc++.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+
+static bool writeAll(int fd, const char *data, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, data, n);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return false;
+    data += w;
+    n -= w;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t n) {
+  while (n > 0) {
+    ssize_t r = read(fd, data, n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return false;
+    data += r;
+    n -= r;
+  }
+  return true;
+}
+
+bool writeField(int fd, const string &data) {
+  uint32_t n = data.size();
+  unsigned char header[4] = {(unsigned char)(n >> 24), (unsigned char)(n >> 16),
+                             (unsigned char)(n >> 8), (unsigned char)n};
+  return writeAll(fd, (const char *)header, 4) && writeAll(fd, data.data(), n);
+}
+
+bool readField(int fd, string &data) {
+  unsigned char header[4];
+  if (!readAll(fd, (char *)header, 4)) return false;
+  uint32_t n = (uint32_t)header[0] << 24 | (uint32_t)header[1] << 16 |
+               (uint32_t)header[2] << 8 | header[3];
+  if (n > MAX_FIELD_BYTES) return false;
+  data.resize(n);
+  return readAll(fd, &data[0], n);
+}
+
+#else
+
+bool writeField(int, const string &) { return false; }
+bool readField(int, string &) { return false; }
+
+#endif
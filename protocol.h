@@ -0,0 +1,20 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Wire format shared by the server and client. Every message is a fixed
+// number of fields, each a 4-byte big-endian length followed by the bytes.
+//
+//   request:  kind ("source" or "path"), program text or path, stdin payload
+//   response: exit status (decimal), stdout, stderr
+//
+// A connection may carry any number of request/response pairs in sequence.
+
+static const uint32_t MAX_FIELD_BYTES = 64u << 20;
+
+bool writeField(int fd, const string &data);
+bool readField(int fd, string &data);
+
+#endif // PROTOCOL_H
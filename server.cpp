@@ -0,0 +1,300 @@
+#include "server.h"
+#include "protocol.h"
+#include <bits/stdc++.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+
+// LRU cache of compiled programs keyed by source hash. The source is kept
+// alongside so a hash collision is treated as a miss rather than running
+// the wrong program. Bounded by entry count and by approximate bytes held.
+class ProgramCache {
+  struct Entry {
+    size_t hash;
+    string source;
+    shared_ptr<const Program> program;
+    size_t bytes;
+  };
+
+  size_t capacity;
+  size_t capacityBytes;
+  size_t usedBytes = 0;
+  list<Entry> lru;  // most recently used first
+  unordered_map<size_t, list<Entry>::iterator> index;
+  mutex lock;
+
+ public:
+  long long hits = 0;
+  long long misses = 0;
+
+  ProgramCache(size_t cap, size_t capBytes) : capacity(max<size_t>(cap, 1)), capacityBytes(capBytes) {}
+
+  shared_ptr<const Program> get(const string &source) {
+    size_t h = hash<string>()(source);
+    {
+      lock_guard<mutex> guard(lock);
+      auto it = index.find(h);
+      if (it != index.end() && it->second->source == source) {
+        lru.splice(lru.begin(), lru, it->second);
+        hits++;
+        return it->second->program;
+      }
+      misses++;
+    }
+
+    // Compile outside the lock so other workers keep serving cached programs
+    shared_ptr<const Program> program = Parser::compile(source);
+
+    size_t bytes = program->bytes + source.capacity();
+    if (bytes > capacityBytes) return program;  // run it, but never keep it
+
+    lock_guard<mutex> guard(lock);
+    auto it = index.find(h);
+    if (it != index.end()) {
+      usedBytes -= it->second->bytes;
+      lru.erase(it->second);
+      index.erase(it);
+    }
+    lru.push_front({h, source, program, bytes});
+    index[h] = lru.begin();
+    usedBytes += bytes;
+    while (lru.size() > capacity || usedBytes > capacityBytes) {
+      usedBytes -= lru.back().bytes;
+      index.erase(lru.back().hash);
+      lru.pop_back();
+    }
+    return program;
+  }
+};
+
+// A client that stalls partway through sending a request or reading a
+// response gives up its worker after this long
+static const int IO_TIMEOUT_SEC = 10;
+
+static volatile sig_atomic_t stopping = 0;
+static atomic<bool> cancelRuns(false);  // stops runs in progress at shutdown
+static int wakeWrite = -1;              // write end of the poll loop's wake-up pipe
+
+static void onSignal(int) {
+  int saved = errno;
+  stopping = 1;
+  char c = 0;
+  if (write(wakeWrite, &c, 1) < 0) {}  // poll() may not have been interrupted
+  errno = saved;
+}
+
+static bool readFile(const string &path, string &contents) {
+  ifstream file(path, ios::binary);
+  if (!file.is_open()) return false;
+  ostringstream ss;
+  ss << file.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+// Read one request from a connection the poll loop found readable, run it
+// and send the response. Returns false once the connection should be closed.
+static bool handleRequest(int fd, ProgramCache &cache, const ServerOptions &opts) {
+  string kind, payload, input;
+  if (!readField(fd, kind) || !readField(fd, payload) || !readField(fd, input)) return false;
+  istringstream in(input);
+  ostringstream out, errs;
+  int status = 1;
+
+  string source;
+  bool haveSource = true;
+  if (kind == "source") {
+    source.swap(payload);
+  } else if (kind == "path") {
+    if (!readFile(payload, source)) {
+      errs << "Error: Could not open " << payload << endl;
+      haveSource = false;
+    }
+  } else {
+    errs << "Error: Unknown request kind '" << kind << "'." << endl;
+    haveSource = false;
+  }
+  if (haveSource && opts.maxSourceBytes > 0 && source.size() > opts.maxSourceBytes) {
+    errs << "Error: Source of " << source.size() << " bytes exceeds the server limit of "
+         << opts.maxSourceBytes << " bytes." << endl;
+    haveSource = false;
+  }
+
+  if (haveSource) {
+    Parser parser(cache.get(source), in, out, errs);
+    parser.setLimits(opts.limits);
+    parser.setCancelFlag(&cancelRuns);
+    status = parser.run();
+  }
+
+  return writeField(fd, to_string(status)) && writeField(fd, out.str()) && writeField(fd, errs.str());
+}
+
+int runServer(const ServerOptions &opts) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (opts.socketPath.size() >= sizeof(addr.sun_path)) {
+    cerr << "Error: Socket path too long: " << opts.socketPath << endl;
+    return 1;
+  }
+  strcpy(addr.sun_path, opts.socketPath.c_str());
+
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(opts.socketPath.c_str());
+  if (listenFd < 0 || ::bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listenFd, 128) < 0) {
+    cerr << "Error: Could not listen on " << opts.socketPath << ": " << strerror(errno) << endl;
+    return 1;
+  }
+
+  // Workers hand connections back to the poll loop through this pipe, and the
+  // signal handler uses it to wake the loop for shutdown
+  int wake[2];
+  if (pipe(wake) < 0) {
+    cerr << "Error: Could not create a pipe: " << strerror(errno) << endl;
+    close(listenFd);
+    return 1;
+  }
+  fcntl(wake[0], F_SETFL, O_NONBLOCK);
+  fcntl(wake[1], F_SETFL, O_NONBLOCK);
+  wakeWrite = wake[1];
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  // Workers take one request at a time, so an idle connection never holds
+  // a worker. Connections move between three places:
+  //   idle      waiting for their next request; owned by the poll loop
+  //   pending   a request is ready to read; queued for the next free worker
+  //   returned  the worker has answered; waiting to rejoin idle
+  ProgramCache cache(opts.cacheSize, opts.cacheBytes);
+  queue<int> pending;
+  vector<int> returned;
+  set<int> active;
+  mutex lock;
+  condition_variable ready;
+  bool closing = false;
+
+  vector<thread> workers;
+  for (int i = 0; i < max(opts.workers, 1); i++) {
+    workers.emplace_back([&]() {
+      while (true) {
+        int fd;
+        {
+          unique_lock<mutex> guard(lock);
+          ready.wait(guard, [&]() { return closing || !pending.empty(); });
+          if (pending.empty()) return;
+          fd = pending.front();
+          pending.pop();
+          active.insert(fd);
+        }
+        bool keep = handleRequest(fd, cache, opts);
+        lock_guard<mutex> guard(lock);
+        active.erase(fd);
+        if (keep && !closing) {
+          returned.push_back(fd);
+          char c = 0;
+          if (write(wake[1], &c, 1) < 0) {}  // a full pipe already means a wake-up is due
+        } else {
+          close(fd);
+        }
+      }
+    });
+  }
+
+  cerr << "Listening on " << opts.socketPath << " with " << workers.size() << " workers" << endl;
+  vector<int> idle;
+  while (!stopping) {
+    vector<pollfd> fds = {{listenFd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+    for (int fd : idle) fds.push_back({fd, POLLIN, 0});
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      cerr << "Error: poll failed: " << strerror(errno) << endl;
+      break;
+    }
+
+    vector<int> stillIdle;
+    {
+      lock_guard<mutex> guard(lock);
+      for (size_t i = 2; i < fds.size(); i++) {
+        if (fds[i].revents) {
+          // A request, or the client hanging up; either way a worker reads it
+          pending.push(fds[i].fd);
+          ready.notify_one();
+        } else {
+          stillIdle.push_back(fds[i].fd);
+        }
+      }
+      if (fds[1].revents) {
+        char drain[256];
+        if (read(wake[0], drain, sizeof(drain)) < 0) {}
+        stillIdle.insert(stillIdle.end(), returned.begin(), returned.end());
+        returned.clear();
+      }
+    }
+    idle.swap(stillIdle);
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        cerr << "Error: accept failed: " << strerror(errno) << endl;
+        break;
+      }
+      timeval timeout = {IO_TIMEOUT_SEC, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      idle.push_back(fd);
+    }
+  }
+
+  // Stop accepting, cancel running programs and drop idle and queued
+  // connections. Active ones are only shut for reading: that wakes a worker
+  // blocked mid-request, while a cancelled run can still send its status
+  cancelRuns = true;
+  close(listenFd);
+  unlink(opts.socketPath.c_str());
+  for (int fd : idle) close(fd);
+  {
+    lock_guard<mutex> guard(lock);
+    closing = true;
+    while (!pending.empty()) {
+      close(pending.front());
+      pending.pop();
+    }
+    for (int fd : returned) close(fd);
+    for (int fd : active) shutdown(fd, SHUT_RD);
+  }
+  ready.notify_all();
+  for (thread &t : workers) t.join();
+  wakeWrite = -1;
+  close(wake[0]);
+  close(wake[1]);
+
+  cerr << "Program cache: " << cache.hits << " hits, " << cache.misses << " misses" << endl;
+  return 0;
+}
+
+#else
+
+int runServer(const ServerOptions &) {
+  cerr << "Error: Server mode needs Unix domain sockets and is not available on this platform." << endl;
+  return 1;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "parser.h"
+#include <bits/stdc++.h>
+using namespace std;
+
+// Limits a request gets unless --time-limit or --max-output is given; a
+// runaway program must not hold a shared worker forever
+static const long long DEFAULT_SERVE_TIME_LIMIT_MS = 10000;
+static const long long DEFAULT_SERVE_MAX_OUTPUT = 16 << 20;
+
+// A compiled program holds up to about 80 bytes of tokens per source byte, so
+// sources are capped and the cache is bounded by memory, not just entries
+static const size_t DEFAULT_SERVE_MAX_SOURCE = 1 << 20;
+static const size_t DEFAULT_SERVE_CACHE_BYTES = 256 << 20;
+
+struct ServerOptions {
+  string socketPath;
+  int workers = 4;
+  size_t cacheSize = 64;                             // compiled programs kept in the LRU cache
+  size_t cacheBytes = DEFAULT_SERVE_CACHE_BYTES;     // approximate memory those programs may hold
+  size_t maxSourceBytes = DEFAULT_SERVE_MAX_SOURCE;  // larger sources are refused; 0 for no cap
+  ExecutionLimits limits;                            // applied to every request
+};
+
+// Serve run requests on a Unix domain socket until SIGINT/SIGTERM.
+// Returns the process exit code.
+int runServer(const ServerOptions &opts);
+
+#endif // SERVER_H
@@ -0,0 +1,64 @@
+#include "../tokenizer.h"
+#include <bits/stdc++.h>
+using namespace std;
+
+// Randomized check that tokenizeParallel() matches the sequential Lexer:
+// same tokens, same line numbers, same diagnostics. Sources are stitched
+// from fragments that stress the split-point rules (strings spanning lines,
+// escaped quotes, comment markers inside strings, stray '/' and '"').
+//
+//   g++ -std=c++11 -O2 -pthread -o lexer_parallel_test tests/lexer_parallel_test.cpp tokenizer.cpp memstats.cpp
+//   ./lexer_parallel_test [iterations] [seed]
+
+static const char *fragments[] = {
+    "purno x = 1;\n", "dekhao << \"a // b\" << x;\n", "// comment \"q\n", "x++;\n",
+    "\"multi\nline\"\n", "/* block\n \"not a string */\n", "\\\"", "\"", "/", "//", "\n",
+    "{", "}", "1abc ", "a.b ", "  ", "\t", "<<=", "&&", "\\", "\"esc\\\"\"\n", "jodi (x<2) {\n"};
+
+static string randomSource(mt19937 &rng) {
+    size_t count = sizeof(fragments) / sizeof(*fragments);
+    size_t size = 70000 + rng() % 400000;  // past the 64KB minimum chunk, so splits happen
+    bool fewQuotes = rng() % 3 != 0;       // unbalanced quotes would leave no safe split point
+    string source;
+    while (source.size() < size) {
+      const char *f = fragments[rng() % count];
+      if (fewQuotes && strchr(f, '"') && rng() % 50) continue;
+      source += f;
+    }
+    return source;
+}
+
+static vector<Token> lexSequential(const string &source, ostream &errors) {
+    Lexer lexer(source.data(), source.data() + source.size(), errors);
+    vector<Token> tokens;
+    for (Token t = lexer.next(); t.type != "EOF"; t = lexer.next()) tokens.push_back(t);
+    return tokens;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    mt19937 rng(argc > 2 ? atoi(argv[2]) : 1);
+    const unsigned threadCounts[] = {2, 4, 8};
+
+    for (int it = 0; it < iterations; it++) {
+      string source = randomSource(rng);
+      ostringstream expectedErrors;
+      vector<Token> expected = lexSequential(source, expectedErrors);
+
+      for (unsigned threads : threadCounts) {
+        ostringstream errors;
+        vector<Token> actual = tokenizeParallel(source, threads, errors);
+        size_t i = 0;
+        while (i < expected.size() && i < actual.size() && expected[i].type == actual[i].type &&
+               expected[i].value == actual[i].value && expected[i].line == actual[i].line)
+          i++;
+        if (i != expected.size() || i != actual.size() || errors.str() != expectedErrors.str()) {
+          cout << "FAIL: iteration " << it << ", " << threads << " threads, first difference at token " << i
+               << " of " << expected.size() << endl;
+          return 1;
+        }
+      }
+    }
+    cout << "OK: " << iterations << " sources, 2/4/8 threads" << endl;
+    return 0;
+}
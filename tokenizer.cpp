@@ -1,8 +1,12 @@
 #include "tokenizer.h"
+#include "memstats.h"
 #include <bits/stdc++.h>
 
 using namespace std;
 
+// Sources are only split into chunks at least this big; smaller ones lex sequentially
+static const size_t MIN_CHUNK_BYTES = 1 << 16;
+
 unordered_set<string> keywords = {"shuru",     "shesh",  "purno",
                                   "vogno",     "jodi",   "nahole",
                                   "jotokkhon", "dekhao", "nao", "shobdo"};
@@ -75,181 +79,278 @@ string removeComments(const string &code) {
   return result;
 }
 
-vector<Token> tokenize(const string &code) {
-  // First remove comments
-  string cleanCode = removeComments(code);
+Lexer::Lexer(istream &input, ostream &errors)
+    : in(&input), chunk(CHUNK_SIZE), err(errors) {}
 
-  vector<Token> tokens;
-  string buffer;
-  bool inString = false;
+Lexer::Lexer(const char *begin, const char *finish, ostream &errors)
+    : cur(begin), end(finish), err(errors) {}
+
+// Next raw source character, refilling the chunk from the stream as needed
+int Lexer::readRaw() {
+  if (cur == end) {
+    if (!in || !*in) return -1;
+    in->read(chunk.data(), chunk.size());
+    cur = chunk.data();
+    end = cur + in->gcount();
+    if (cur == end) return -1;
+  }
+  return (unsigned char)*cur++;
+}
+
+int Lexer::peekRaw() {
+  int c = readRaw();
+  if (c >= 0) cur--;
+  return c;
+}
+
+// Next character with comments removed, same rules as removeComments()
+int Lexer::readChar() {
+  if (aheadChar != -2) {
+    int c = aheadChar;
+    aheadChar = -2;
+    return c;
+  }
+
+  int c = readRaw();
+  if (c < 0) return -1;
+  int prev = prevRaw;
+  prevRaw = c;
+
+  // Handle string literals
+  if (c == '"' && prev != '\\') {
+    commentInString = !commentInString;
+    return c;
+  }
+  if (commentInString) return c;
+
+  // Skip single-line comment, keeping its newline
+  if (c == '/' && peekRaw() == '/') {
+    while (c >= 0 && c != '\n') {
+      c = readRaw();
+    }
+    if (c < 0) return -1;
+    prevRaw = c;
+  }
+  return c;
+}
 
-  for (size_t i = 0; i < cleanCode.size(); i++) {
-    char c = cleanCode[i];
+int Lexer::peekChar() {
+  if (aheadChar == -2) aheadChar = readChar();
+  return aheadChar;
+}
+
+// Classify the pending word as keyword, literal or identifier
+void Lexer::flushBuffer() {
+  if (buffer.empty()) return;
+  if (keywords.count(buffer)) {
+    pending.push_back({"KEYWORD", buffer, bufferLine});
+  }
+  else if (isNumber(buffer)) {
+    if (buffer.find('.') != string::npos) {
+      pending.push_back({"VOGNO_LITERAL", buffer, bufferLine});
+    } else {
+      pending.push_back({"PURNO_LITERAL", buffer, bufferLine});
+    }
+  }
+  else {
+    if (!isValidIdentifier(buffer)) {
+      err << "Invalid identifier: " << buffer << endl;
+    }
+    else {
+      pending.push_back({"IDENTIFIER", buffer, bufferLine});
+    }
+  }
+  buffer.clear();
+}
+
+// Consume characters until at least one more token is pending or input ends
+void Lexer::produce() {
+  MemPhaseScope phase(PHASE_LEX);
+  size_t target = pending.size() + 1;
+  while (pending.size() < target && !finished) {
+    int c = readChar();
+
+    if (c < 0) {
+      flushBuffer();
+      finished = true;
+      break;
+    }
+    if (c == '\n') line++;
 
     if (c == '"') {
       if (inString) {
-        tokens.push_back({"STRING", buffer});
+        pending.push_back({"STRING", buffer, bufferLine});
         buffer.clear();
         inString = false;
       } else {
         inString = true;
+        bufferLine = line;
       }
       continue;
     }
 
     if (inString) {
-      buffer += c;
+      buffer += (char)c;
       continue;
     }
 
     if (isspace(c)) {
-      if (!buffer.empty()) {
-        if (keywords.count(buffer)) {
-          tokens.push_back({"KEYWORD", buffer});
-        }
-        else if (isNumber(buffer)) {
-          if (buffer.find('.') != string::npos) {
-            tokens.push_back({"VOGNO_LITERAL", buffer});
-          } else {
-            tokens.push_back({"PURNO_LITERAL", buffer});
-          }
-        }
-        else {
-          if (!isValidIdentifier(buffer)) {
-            cerr << "Invalid identifier: " << buffer << endl;
-          }
-          else {
-            tokens.push_back({"IDENTIFIER", buffer});
-          }
-        }
-        buffer.clear();
-      }
+      flushBuffer();
       continue;
     }
 
     if (c == '{' || c == '}') {
-      if (!buffer.empty()) {
-        if (keywords.count(buffer))
-          tokens.push_back({"KEYWORD", buffer});
-        else if (isNumber(buffer)) {
-          if (buffer.find('.') != string::npos) {
-            tokens.push_back({"VOGNO_LITERAL", buffer});
-          } else {
-            tokens.push_back({"PURNO_LITERAL", buffer});
-          }
-        }
-        else {
-          if (!isValidIdentifier(buffer)) {
-            cerr << "Invalid identifier: " << buffer << endl;
-          }
-          else {
-            tokens.push_back({"IDENTIFIER", buffer});
-          }
-        }
-        buffer.clear();
-      }
-
-      tokens.push_back({"BRACE", string(1, c)});
+      flushBuffer();
+      pending.push_back({"BRACE", string(1, (char)c), line});
       continue;
     }
 
     if (c == '=' || c == '<' || c == '>' || c == '+' || c == '-' || c == '*' ||
-        c == '/' || c == '(' || c == ')' || c == ';' || c == ',' || c == '&' || c == '|' || c == '!') {
-      if (!buffer.empty()) {
-        if (keywords.count(buffer))
-          tokens.push_back({"KEYWORD", buffer});
-        else if (isNumber(buffer)) {
-          if (buffer.find('.') != string::npos) {
-            tokens.push_back({"VOGNO_LITERAL", buffer});
-          } else {
-            tokens.push_back({"PURNO_LITERAL", buffer});
-          }
-        }
-        else {
-          if (!isValidIdentifier(buffer)) {
-            cerr << "Invalid identifier: " << buffer << endl;
-          }
-          else {
-            tokens.push_back({"IDENTIFIER", buffer});
-          }
-        }
-        buffer.clear();
-      }
+        c == '/' || c == '(' || c == ')' || c == ';' || c == ',' || c == '&' || c == '|' || c == '!' ||
+        c == '[' || c == ']') {
+      flushBuffer();
 
-      string op(1, c);
+      string op(1, (char)c);
+      int n = peekChar();
       // Handle -- (decrement)
-      if (c == '-' && i + 1 < cleanCode.size() && cleanCode[i + 1] == '-') {
+      if (c == '-' && n == '-') {
         op += '-';
-        i++;
       }
       // Handle ++ (increment)
-      else if (c == '+' && i + 1 < cleanCode.size() &&
-               cleanCode[i + 1] == '+') {
+      else if (c == '+' && n == '+') {
         op += '+';
-        i++;
       }
       // Handle && (logical AND)
-      else if (c == '&' && i + 1 < cleanCode.size() &&
-               cleanCode[i + 1] == '&') {
+      else if (c == '&' && n == '&') {
         op = "&&";
-        i++;
       }
       // Handle || (logical OR)
-      else if (c == '|' && i + 1 < cleanCode.size() &&
-               cleanCode[i + 1] == '|') {
+      else if (c == '|' && n == '|') {
         op = "||";
-        i++;
       }
       // Handle << (left shift / output)
-      else if (c == '<' && i + 1 < cleanCode.size() &&
-               cleanCode[i + 1] == '<') {
+      else if (c == '<' && n == '<') {
         op += '<';
-        i++;
       }
       // Handle >> (right shift / input)
-      else if (c == '>' && i + 1 < cleanCode.size() &&
-               cleanCode[i + 1] == '>') {
+      else if (c == '>' && n == '>') {
         op += '>';
-        i++;
       }
       // Handle <=, >=, ==, !=
-      else if ((c == '<' || c == '>' || c == '=' || c == '!') && i + 1 < cleanCode.size() &&
-               cleanCode[i + 1] == '=') {
+      else if ((c == '<' || c == '>' || c == '=' || c == '!') && n == '=') {
         op += '=';
-        i++;
       }
       // Handle +=, -=, *=, /=
-      else if ((c == '+' || c == '-' || c == '*' || c == '/') && i + 1 < cleanCode.size() && cleanCode[i+1] == '=') {
+      else if ((c == '+' || c == '-' || c == '*' || c == '/') && n == '=') {
         op += '=';
-        i++;
       }
+      if (op.size() > 1) readChar();
 
-      tokens.push_back({"OPERATOR", op});
+      pending.push_back({"OPERATOR", op, line});
       continue;
     }
 
-    buffer += c;
+    if (buffer.empty()) bufferLine = line;
+    buffer += (char)c;
   }
+}
 
-  if (!buffer.empty()) {
-    if (keywords.count(buffer))
-      tokens.push_back({"KEYWORD", buffer});
-    else if (isNumber(buffer)) {
-      if (buffer.find('.') != string::npos) {
-        tokens.push_back({"VOGNO_LITERAL", buffer});
-      } else {
-        tokens.push_back({"PURNO_LITERAL", buffer});
-      }
+Token Lexer::next() {
+  if (pending.empty()) produce();
+  if (pending.empty()) return {"EOF", "", 0};
+  Token t = std::move(pending.front());
+  pending.pop_front();
+  return t;
+}
+
+Token Lexer::peek(size_t k) {
+  while (pending.size() <= k && !finished) produce();
+  if (k < pending.size()) return pending[k];
+  return {"EOF", "", 0};
+}
+
+vector<Token> tokenize(const string &code) {
+  Lexer lexer(code.data(), code.data() + code.size());
+  vector<Token> tokens;
+  for (Token t = lexer.next(); t.type != "EOF"; t = lexer.next()) {
+    tokens.push_back(t);
+  }
+  return tokens;
+}
+
+// Lex large sources on several threads. A quick pre-pass tracks only the
+// string and comment state and picks, for each chunk, the first newline
+// past the target size that is outside any string literal or comment.
+// At such a point the lexer is in its initial state, so each chunk can be
+// lexed independently and the results concatenated. Tokens and
+// diagnostics come out exactly as from tokenize().
+vector<Token> tokenizeParallel(const string &code, unsigned threads, ostream &errors) {
+  size_t n = code.size();
+  size_t chunkBytes = max(MIN_CHUNK_BYTES, n / max(threads, 1u));
+
+  vector<size_t> starts(1, 0);
+  vector<int> lines(1, 1);
+  bool commentInString = false;  // string state as seen by comment removal
+  bool tokenInString = false;    // string state as seen by the tokenizer
+  int line = 1;
+  size_t target = chunkBytes;
+  for (size_t i = 0; i < n && threads > 1; i++) {
+    char c = code[i];
+    if (c == '"') {
+      tokenInString = !tokenInString;
+      if (i == 0 || code[i - 1] != '\\') commentInString = !commentInString;
+      continue;
     }
-    else {
-      if (!isValidIdentifier(buffer)) {
-        cerr << "Invalid identifier: " << buffer << endl;
-      }
-      else {
-        tokens.push_back({"IDENTIFIER", buffer});
+    if (!commentInString && c == '/' && i + 1 < n && code[i + 1] == '/') {
+      const void *eol = memchr(code.data() + i, '\n', n - i);
+      if (!eol) break;
+      i = (const char *)eol - code.data();
+      c = '\n';
+    }
+    if (c == '\n') {
+      line++;
+      if (i + 1 >= target && i + 1 < n && !commentInString && !tokenInString) {
+        starts.push_back(i + 1);
+        lines.push_back(line);
+        target = i + 1 + chunkBytes;
       }
     }
   }
+  starts.push_back(n);
+
+  size_t chunks = starts.size() - 1;
+  vector<vector<Token>> parts(chunks);
+  vector<ostringstream> diagnostics(chunks);
+  auto lexChunk = [&](size_t k) {
+    MemPhaseScope phase(PHASE_LEX);  // the phase is per thread
+    Lexer lexer(code.data() + starts[k], code.data() + starts[k + 1], diagnostics[k]);
+    lexer.startAtLine(lines[k]);
+    for (Token t = lexer.next(); t.type != "EOF"; t = lexer.next()) {
+      parts[k].push_back(std::move(t));
+    }
+  };
+
+  vector<thread> workers;
+  for (size_t k = 1; k < chunks; k++) workers.emplace_back(lexChunk, k);
+  lexChunk(0);
+  for (thread &t : workers) t.join();
+  if (chunks == 1) {
+    errors << diagnostics[0].str();
+    return std::move(parts[0]);
+  }
+
+  // Move each chunk's tokens into place, again in parallel
+  vector<size_t> offsets(chunks + 1, 0);
+  for (size_t k = 0; k < chunks; k++) offsets[k + 1] = offsets[k] + parts[k].size();
+  vector<Token> tokens(offsets[chunks]);
+  auto place = [&](size_t k) {
+    move(parts[k].begin(), parts[k].end(), tokens.begin() + offsets[k]);
+  };
+  workers.clear();
+  for (size_t k = 1; k < chunks; k++) workers.emplace_back(place, k);
+  place(0);
+  for (thread &t : workers) t.join();
 
+  for (size_t k = 0; k < chunks; k++) errors << diagnostics[k].str();
   return tokens;
 }
@@ -7,9 +7,51 @@ using namespace std;
 struct Token {
   string type;
   string value;
+  int line;    // source line the token starts on, 0 if synthesized
+};
+
+// Pull-based lexer. Source is read in fixed-size chunks and comments are
+// stripped on the fly, so only the current chunk and the pending lookahead
+// tokens are held in memory no matter how large the program is.
+class Lexer {
+  static const size_t CHUNK_SIZE = 1 << 16;
+
+  istream *in = nullptr;       // null when lexing an in-memory buffer
+  vector<char> chunk;
+  const char *cur = nullptr;
+  const char *end = nullptr;
+  ostream &err;
+
+  // Comment stripping state (mirrors removeComments)
+  bool commentInString = false;
+  int prevRaw = 0;
+  int aheadChar = -2;          // one buffered comment-free char, -2 = none
+
+  // Token state
+  string buffer;
+  int line = 1;
+  int bufferLine = 1;          // line where the pending word or string began
+  bool inString = false;
+  bool finished = false;
+  deque<Token> pending;
+
+  int readRaw();
+  int peekRaw();
+  int readChar();
+  int peekChar();
+  void flushBuffer();
+  void produce();
+
+ public:
+  explicit Lexer(istream &input, ostream &errors = cerr);
+  Lexer(const char *begin, const char *finish, ostream &errors = cerr);
+  Token next();
+  Token peek(size_t k = 0);
+  void startAtLine(int n) { line = bufferLine = n; }
 };
 
 vector<Token> tokenize(const string &code);
+vector<Token> tokenizeParallel(const string &code, unsigned threads, ostream &errors = cerr);
 bool isNumber(const string &s);
 bool isValidIdentifier(const string &s);
 string removeComments(const string &code);
@@ -0,0 +1,144 @@
+#include "../protocol.h"
+#include <bits/stdc++.h>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Client for `compiler --serve`. With one request it behaves like running
+// the compiler directly; with more it acts as a load generator and reports
+// latency percentiles and throughput.
+
+static void usage() {
+  cerr << "Usage: client SOCKET (--source FILE | --path FILE) [--stdin FILE]"
+       << " [--requests N] [--concurrency C]" << endl;
+}
+
+static int connectTo(const string &socketPath) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) return -1;
+  strcpy(addr.sun_path, socketPath.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool readFile(const string &path, string &contents) {
+  ifstream file(path, ios::binary);
+  if (!file.is_open()) return false;
+  ostringstream ss;
+  ss << file.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+static bool roundTrip(int fd, const string &kind, const string &payload, const string &input,
+                      string &status, string &out, string &errs) {
+  return writeField(fd, kind) && writeField(fd, payload) && writeField(fd, input) &&
+         readField(fd, status) && readField(fd, out) && readField(fd, errs);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  string socketPath = argv[1];
+  string kind, payload, input;
+  long long requests = 1;
+  int concurrency = 1;
+  for (int i = 2; i < argc; i++) {
+    string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    string value = argv[++i];
+    if (arg == "--path") {
+      kind = "path";
+      payload = value;
+    } else if (arg == "--source") {
+      kind = "source";
+      if (!readFile(value, payload)) {
+        cerr << "Error: Could not open " << value << endl;
+        return 1;
+      }
+    } else if (arg == "--stdin") {
+      if (!readFile(value, input)) {
+        cerr << "Error: Could not open " << value << endl;
+        return 1;
+      }
+    } else if (arg == "--requests") {
+      requests = max(1LL, atoll(value.c_str()));
+    } else if (arg == "--concurrency") {
+      concurrency = max(1, atoi(value.c_str()));
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (kind.empty()) {
+    usage();
+    return 1;
+  }
+
+  if (requests == 1) {
+    int fd = connectTo(socketPath);
+    string status, out, errs;
+    if (fd < 0 || !roundTrip(fd, kind, payload, input, status, out, errs)) {
+      cerr << "Error: Request to " << socketPath << " failed" << endl;
+      return 1;
+    }
+    close(fd);
+    cout << out;
+    cerr << errs;
+    return atoi(status.c_str());
+  }
+
+  // Load generation: each thread keeps one connection and sends requests back to back
+  atomic<long long> next(0), failures(0);
+  vector<vector<double>> latencies(concurrency);
+  vector<thread> threads;
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < concurrency; t++) {
+    threads.emplace_back([&, t]() {
+      int fd = connectTo(socketPath);
+      string status, out, errs;
+      while (next.fetch_add(1) < requests) {
+        auto begin = chrono::steady_clock::now();
+        if (fd < 0 || !roundTrip(fd, kind, payload, input, status, out, errs)) {
+          failures++;
+          continue;
+        }
+        auto end = chrono::steady_clock::now();
+        latencies[t].push_back(chrono::duration<double, micro>(end - begin).count());
+      }
+      if (fd >= 0) close(fd);
+    });
+  }
+  for (thread &t : threads) t.join();
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  vector<double> all;
+  for (const auto &l : latencies) all.insert(all.end(), l.begin(), l.end());
+  sort(all.begin(), all.end());
+  auto percentile = [&](double p) {
+    return all.empty() ? 0.0 : all[min(all.size() - 1, (size_t)(p * all.size()))];
+  };
+
+  cout << fixed << setprecision(1);
+  cout << "requests:    " << all.size() << " ok, " << failures << " failed" << endl;
+  cout << "concurrency: " << concurrency << endl;
+  cout << "throughput:  " << all.size() / seconds << " req/s" << endl;
+  cout << "latency p50: " << percentile(0.50) << " us" << endl;
+  cout << "latency p99: " << percentile(0.99) << " us" << endl;
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Counts the user-mode instructions a command executes by single-stepping
+// it with ptrace. Unlike wall time the count does not depend on machine
+// load, so small overheads can be compared between two builds. Slow (about
+// 100k instructions per second), so use it on short runs. The command's
+// stdout is discarded.
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: icount COMMAND [ARGS...]" << endl;
+    return 1;
+  }
+
+  pid_t child = fork();
+  if (child < 0) {
+    cerr << "Error: fork failed: " << strerror(errno) << endl;
+    return 1;
+  }
+  if (child == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) dup2(null, STDOUT_FILENO);
+    ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+    execvp(argv[1], argv + 1);
+    _exit(127);
+  }
+
+  // The child stops at exec; count every step from there until it exits
+  int st;
+  waitpid(child, &st, 0);
+  long long count = 0;
+  int signal = 0;  // a real signal (not a step trap) is passed on to the child
+  while (WIFSTOPPED(st) && ptrace(PTRACE_SINGLESTEP, child, nullptr, (void *)(long)signal) == 0) {
+    waitpid(child, &st, 0);
+    if (!WIFSTOPPED(st)) break;
+    signal = WSTOPSIG(st) == SIGTRAP ? 0 : WSTOPSIG(st);
+    count++;
+  }
+  if (WIFEXITED(st) && WEXITSTATUS(st) == 127) {
+    cerr << "Error: Could not run " << argv[1] << endl;
+    return 1;
+  }
+  cout << count << endl;
+  return 0;
+}